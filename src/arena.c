@@ -0,0 +1,92 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "arena.h"
+
+/* Code for the arena allocator. Check structs declaration in arena.h */
+
+//Blocks given back by closed arenas, ready to be reused. Each thread has its own list, so no locking is needed
+_Thread_local arena_block* free_blocks = NULL;
+
+_Thread_local long arena_bytes_allocated = 0;
+_Thread_local long arena_blocks_created = 0;
+_Thread_local long arena_allocations = 0;
+
+
+//Initialize an empty arena. No memory is taken until the first allocation
+void arena_init(arena* a) {
+    a->head = NULL;
+    a->tail = NULL;
+}
+
+//Get a block with at least 'size' usable bytes, reusing a free one if possible
+arena_block* get_block(size_t size) {
+    arena_block* block;
+
+    if (free_blocks != NULL && free_blocks->capacity >= size) {
+        block = free_blocks;
+        free_blocks = free_blocks->next;
+    } else {
+        size_t capacity = (size > ARENA_BLOCK_SIZE) ? size : ARENA_BLOCK_SIZE;
+        block = malloc(sizeof(arena_block) + capacity);
+        if (block == NULL) {
+            fprintf(stderr, "Out of memory\n");
+            exit(1);
+        }
+        block->capacity = capacity;
+        arena_blocks_created++;
+    }
+
+    block->used = 0;
+    block->next = NULL;
+    return block;
+}
+
+//Allocate 'size' bytes from the arena. The memory is not initialized, and it is aligned to 8 bytes
+void* arena_alloc(arena* a, size_t size) {
+    size = (size + 7) & ~((size_t) 7);
+
+    if (a->head == NULL || a->head->used + size > a->head->capacity) {
+        arena_block* block = get_block(size);
+        block->next = a->head;
+
+        if (a->head == NULL)
+            a->tail = block;
+        a->head = block;
+    }
+
+    void* ptr = a->head->data + a->head->used;
+    a->head->used += size;
+    arena_bytes_allocated += size;
+    arena_allocations++;
+
+    return ptr;
+}
+
+//Copy the first 'length' characters of the text into the arena, adding the terminator
+char* arena_strndup(arena* a, const char* text, size_t length) {
+    char* copy = arena_alloc(a, length + 1);
+    memcpy(copy, text, length);
+    copy[length] = '\0';
+
+    return copy;
+}
+
+//Release all the memory of the arena at once: its blocks are moved to the free list in constant time
+void arena_release(arena* a) {
+    if (a->head != NULL) {
+        a->tail->next = free_blocks;
+        free_blocks = a->head;
+    }
+    a->head = NULL;
+    a->tail = NULL;
+}
+
+//Give back to the system the blocks in the free list of the thread, called when it has no more compilations to run
+void arena_free_all() {
+    while (free_blocks != NULL) {
+        arena_block* next = free_blocks->next;
+        free(free_blocks);
+        free_blocks = next;
+    }
+}
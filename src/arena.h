@@ -0,0 +1,36 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+/* Region-based memory allocator. Memory is taken from big blocks and released all together,
+   instead of calling malloc and free for every element. See arena.c for the implementation */
+
+#define ARENA_BLOCK_SIZE 4096   //Default size of a block, bigger requests get a dedicated block
+
+//Struct describing a chunk of memory from which allocations are taken sequentially
+typedef struct arena_block {
+    struct arena_block* next;   //Previously filled block of the same arena (or next free block, when in the free list)
+    size_t capacity;            //Usable bytes in 'data'
+    size_t used;                //Bytes already handed out
+    char data[];
+} arena_block;
+
+//Struct defining an arena: a list of blocks, where only the head one is used for new allocations
+typedef struct arena {
+    arena_block* head;          //Block currently used for allocations
+    arena_block* tail;          //Oldest block, needed to give the whole list back to the free list in O(1)
+} arena;
+
+//Counters of the current thread, useful to check the memory usage of the compiler
+extern _Thread_local long arena_bytes_allocated;    //Bytes handed out by arena_alloc
+extern _Thread_local long arena_blocks_created;     //Blocks obtained from malloc (blocks reused from the free list are not counted)
+extern _Thread_local long arena_allocations;        //Calls of arena_alloc
+
+void arena_init(arena* a);
+void* arena_alloc(arena* a, size_t size);
+char* arena_strndup(arena* a, const char* text, size_t length);
+void arena_release(arena* a);
+void arena_free_all();
+
+#endif
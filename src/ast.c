@@ -0,0 +1,218 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ast.h"
+#include "compilation.h"
+
+/* Code for the abstract syntax tree. Check structs declaration in ast.h
+   Nodes are allocated in the compilation memory, since the tree is used after all the blocks have been closed */
+
+
+//Create a node of the given kind, with all the children empty
+node* create_node(int kind, int type, int line_number) {
+    node* n = arena_alloc(&context->memory, sizeof(node));
+    memset(n, 0, sizeof(node));
+
+    n->kind = kind;
+    n->type = type;
+    n->line_number = line_number;
+    n->number = context->temp_count++;
+    n->slot = -1;
+
+    return n;
+}
+
+//Create a constant node from the temporary built by LEX, which is given back to the pool
+node* make_constant_node(elem* constant) {
+    node* n = create_node(NODE_CONSTANT, constant->type, constant->line_number);
+    n->number = ((temp_elem*) constant)->number;    //Keep the name of the temporary, used in messages
+    n->value = constant->value;
+
+    release_temp_element(constant);
+    return n;
+}
+
+//Create a node reading a declared variable. Name and register are copied, since the symbol
+// is dropped together with its block while the tree is still needed
+node* make_variable_node(int symbol) {
+    node* n = create_node(NODE_VARIABLE, context->symbols.types[symbol], context->number_line);
+    n->name = context->symbols.ids[symbol]->name;
+    n->slot = context->symbols.slots[symbol];
+
+    return n;
+}
+
+//Create a node applying an operator. For NOT, 'right' is NULL
+node* make_operation_node(int op, int type, node* left, node* right) {
+    node* n = create_node(NODE_OPERATION, type, left->line_number);
+    n->op = op;
+    n->left = left;
+    n->right = right;
+
+    return n;
+}
+
+//Create a node converting an operand to a different type (INT to REAL)
+node* make_conversion_node(node* operand, int type) {
+    node* n = create_node(NODE_CONVERT, type, operand->line_number);
+    n->left = operand;
+
+    return n;
+}
+
+//Create a node storing the value of an expression into a variable
+node* make_assign_node(int symbol, node* value) {
+    node* n = create_node(NODE_ASSIGN, context->symbols.types[symbol], value->line_number);
+    n->name = context->symbols.ids[symbol]->name;
+    n->slot = context->symbols.slots[symbol];
+    n->left = value;
+
+    return n;
+}
+
+//Create an empty list of statements
+node* make_block_node() {
+    return create_node(NODE_BLOCK, UNKNOWN_TYPE, context->number_line);
+}
+
+//Add a statement at the end of a block. Return the block itself, to be used directly in YACC rules
+node* append_statement(node* block, node* statement) {
+    if (statement == NULL)
+        return block;
+
+    statement->next = NULL;
+    if (block->first == NULL)
+        block->first = statement;
+    else
+        block->last->next = statement;
+    block->last = statement;
+
+    return block;
+}
+
+//Move all the statements of 'other' at the end of 'block'
+node* append_block(node* block, node* other) {
+    if (other->first != NULL) {
+        if (block->first == NULL)
+            block->first = other->first;
+        else
+            block->last->next = other->first;
+        block->last = other->last;
+    }
+    return block;
+}
+
+node* make_if_node(node* condition, node* body, node* else_body) {
+    node* n = create_node(NODE_IF, UNKNOWN_TYPE, condition->line_number);
+    n->condition = condition;
+    n->body = body;
+    n->else_body = else_body;
+
+    return n;
+}
+
+node* make_while_node(node* condition, node* body) {
+    node* n = create_node(NODE_WHILE, UNKNOWN_TYPE, condition->line_number);
+    n->condition = condition;
+    n->body = body;
+
+    return n;
+}
+
+node* make_for_node(node* init, node* condition, node* step, node* body) {
+    node* n = create_node(NODE_FOR, UNKNOWN_TYPE, condition->line_number);
+    n->init = init;
+    n->condition = condition;
+    n->step = step;
+    n->body = body;
+
+    return n;
+}
+
+//Create a case of a switch. The comparison with the scrutinee is added by check_switch_cases (see type_checking.c)
+node* make_case_node(node* constant, node* body) {
+    node* n = create_node(NODE_CASE, UNKNOWN_TYPE, constant->line_number);
+    n->left = constant;
+    n->body = body;
+
+    return n;
+}
+
+//Create a switch. 'cases' is a block whose statements are NODE_CASE, 'default_body' may be NULL
+node* make_switch_node(node* scrutinee, node* cases, node* default_body) {
+    node* n = create_node(NODE_SWITCH, UNKNOWN_TYPE, scrutinee->line_number);
+    n->init = scrutinee;
+    n->first = cases->first;
+    n->last = cases->last;
+    n->else_body = default_body;
+
+    return n;
+}
+
+//Compare two case keys by value, then by source line, so that the first of equal keys is the earliest case
+int compare_case_keys(const void* first, const void* second) {
+    const case_key* x = first;
+    const case_key* y = second;
+
+    if (x->integer != y->integer)
+        return (x->integer < y->integer) ? -1 : 1;
+    if (x->real != y->real)
+        return (x->real < y->real) ? -1 : 1;
+    return x->index - y->index;
+}
+
+//Fill 'keys' with the keys of the cases starting at 'first_case', sorted by value, and return their number.
+// Cases whose comparison with the scrutinee has errors, or has been folded, get no key
+int get_case_keys(node* first_case, case_key* keys) {
+    int count = 0, index = 0;
+
+    for (node* c = first_case; c != NULL; c = c->next, index++) {
+        if (c->condition == NULL || c->condition->kind != NODE_OPERATION || c->condition->type == ERROR_TYPE)
+            continue;
+
+        case_key* k = &keys[count++];
+        values* v = &c->left->value;
+        k->type = c->condition->left->type;
+        k->integer = 0;
+        k->real = 0;
+        k->c = c;
+        k->index = index;
+
+        switch(k->type) {
+            case REAL_TYPE:
+                k->real = (c->left->type == REAL_TYPE) ? v->f : v->i;
+                break;
+            case STRING_TYPE:
+                k->integer = (long) v->s;         //Interned: equal texts have the same address
+                break;
+            case CHAR_TYPE:
+                k->integer = v->c;
+                break;
+            case BOOL_TYPE:
+                k->integer = v->b;
+                break;
+            default:
+                k->integer = v->i;
+                break;
+        }
+    }
+
+    qsort(keys, count, sizeof(case_key), compare_case_keys);
+    return count;
+}
+
+//Create the node standing for a part of the program that contains errors. Its ERROR_TYPE is accepted by the type checker
+// without further messages, and the program is never translated when errors were found (see diagnostics.h)
+node* make_error_node() {
+    return create_node(NODE_ERROR, ERROR_TYPE, context->number_line);
+}
+
+//Return the name used for a node in messages: variables use their own name, other nodes have the form "t1"
+char* get_node_name(node* n) {
+    if (n->name == NULL) {
+        char name[16];
+        int length = sprintf(name, "t%d", n->number);
+        n->name = arena_strndup(&context->memory, name, length);
+    }
+    return n->name;
+}
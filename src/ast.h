@@ -0,0 +1,78 @@
+#ifndef AST_H
+#define AST_H
+
+/* Abstract syntax tree built by the parser. Every node already carries the data type of its result,
+   checked in type_checking.c, and the tree is translated into bytecode by bytecode.c */
+
+// Internal identifiers needed to distinguish the different kinds of node
+#define NODE_CONSTANT 1     //Literal value
+#define NODE_VARIABLE 2     //Read of a declared variable
+#define NODE_OPERATION 3    //Arithmetical, logical or comparison operator applied to one or two operands
+#define NODE_CONVERT 4      //Conversion of an INT operand to REAL, added by the type checker
+#define NODE_ASSIGN 5       //Assignment (or initialization) of a variable
+#define NODE_BLOCK 6        //List of statements
+#define NODE_IF 7
+#define NODE_WHILE 8
+#define NODE_FOR 9
+#define NODE_SWITCH 10
+#define NODE_CASE 11
+#define NODE_ERROR 12     //Placeholder for an expression or a statement containing errors, never translated
+
+
+//Struct defining a node of the tree. Depending on the kind, just some of the fields are used
+typedef struct node {
+    int kind;               //Kind of node (from the above define list)
+    int type;               //Data type of the result, for expressions (see sym_table.h)
+    int op;                 //Operator token (PLUS, MINUS, ...) of NODE_OPERATION
+    int line_number;        //Line where the node was parsed
+    int number;             //Progressive number, used to name intermediate results in messages ("t<number>")
+
+    char* name;             //Name of the variable, for NODE_VARIABLE and NODE_ASSIGN
+    int slot;               //Register holding the variable, for NODE_VARIABLE and NODE_ASSIGN
+    values value;           //Content of NODE_CONSTANT
+
+    struct node* left;      //First operand, or value of an assignment
+    struct node* right;     //Second operand (NULL for NOT)
+    struct node* condition; //Condition of if, while and for; comparison selecting a case
+    struct node* body;      //Statements executed when the condition holds
+    struct node* else_body; //Statements executed otherwise: else branch, or default of a switch
+    struct node* init;      //Declarations of a for loop, scrutinee of a switch
+    struct node* step;      //Assignment performed at the end of each iteration of a for loop
+
+    struct node* first;     //First statement of a block (or first case of a switch)
+    struct node* last;      //Last statement of a block, to append new statements in constant time
+    struct node* next;      //Next statement in the same block
+} node;
+
+//Struct holding the value selecting a case of a switch, converted to the type in which it is compared with the scrutinee.
+// Keys are sorted by value to find duplicates (see type_checking.c) and to lower the switch (see bytecode.c)
+typedef struct case_key {
+    int type;               //Type of the comparison: the scrutinee's one, unless one of the two is converted to REAL
+    long integer;           //Value of INT, CHAR and BOOL keys, address of the interned text of STRING keys
+    double real;            //Value of REAL keys
+    node* c;                //NODE_CASE selected by the key
+    int index;              //Position of the case in the switch
+} case_key;
+
+
+//Function signatures, see ast.c for implementation
+
+node* create_node(int kind, int type, int line_number);
+node* make_constant_node(elem* constant);
+node* make_variable_node(int symbol);
+node* make_operation_node(int op, int type, node* left, node* right);
+node* make_conversion_node(node* operand, int type);
+node* make_assign_node(int symbol, node* value);
+node* make_block_node();
+node* append_statement(node* block, node* statement);
+node* append_block(node* block, node* other);
+node* make_if_node(node* condition, node* body, node* else_body);
+node* make_while_node(node* condition, node* body);
+node* make_for_node(node* init, node* condition, node* step, node* body);
+node* make_case_node(node* constant, node* body);
+node* make_switch_node(node* scrutinee, node* cases, node* default_body);
+node* make_error_node();
+int get_case_keys(node* first_case, case_key* keys);
+char* get_node_name(node* n);
+
+#endif
@@ -0,0 +1,219 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "bytecode.h"
+#include "compilation.h"
+#include "batch.h"
+
+/* Batch compilation of many files on a pool of threads. Check structs declaration in batch.h */
+
+
+//Add a file to the batch
+void add_batch_file(batch* work, const char* path) {
+    if (work->count == work->capacity) {
+        work->capacity = (work->capacity == 0) ? 64 : work->capacity * 2;
+        work->results = realloc(work->results, work->capacity * sizeof(batch_result));
+    }
+    batch_result* result = &work->results[work->count++];
+    memset(result, 0, sizeof(batch_result));
+    result->path = strdup(path);
+}
+
+int compare_results(const void* first, const void* second) {
+    return strcmp(((batch_result*) first)->path, ((batch_result*) second)->path);
+}
+
+//Add every .c file found in a directory and in its subdirectories
+void add_batch_directory(batch* work, const char* path) {
+    DIR* directory = opendir(path);
+    struct dirent* entry;
+    struct stat info;
+    char child[4096];
+
+    if (directory == NULL)
+        return;
+    while ((entry = readdir(directory)) != NULL) {
+        if (entry->d_name[0] == '.')
+            continue;
+        snprintf(child, sizeof(child), "%s/%s", path, entry->d_name);
+        if (stat(child, &info) != 0)
+            continue;
+
+        size_t length = strlen(entry->d_name);
+        if (S_ISDIR(info.st_mode))
+            add_batch_directory(work, child);
+        else if (S_ISREG(info.st_mode) && length > 2 && strcmp(entry->d_name + length - 2, ".c") == 0)
+            add_batch_file(work, child);
+    }
+    closedir(directory);
+}
+
+//Collect the files of the batch: the .c files of a directory (sorted by path), or the files listed one per line in a text file
+bool collect_batch_files(batch* work, char* path) {
+    struct stat info;
+    if (stat(path, &info) != 0)
+        return false;
+
+    if (S_ISDIR(info.st_mode)) {
+        add_batch_directory(work, path);
+        qsort(work->results, work->count, sizeof(batch_result), compare_results);
+        return true;
+    }
+
+    FILE* list = fopen(path, "r");
+    char line[4096];
+    if (list == NULL)
+        return false;
+    while (fgets(line, sizeof(line), list) != NULL) {
+        line[strcspn(line, "\r\n")] = '\0';
+        if (line[0] != '\0')
+            add_batch_file(work, line);
+    }
+    fclose(list);
+    return true;
+}
+
+//Compile and execute one file in a new context. Errors are collected without being printed, and do not terminate
+// the process: stop_compilation jumps back here, and the first message is kept in the result
+void compile_file(batch_result* result, int input_mode) {
+    struct timespec start, end;
+    jmp_buf on_error;
+    program* volatile p = NULL;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    compilation* c = create_compilation();
+    c->on_error = &on_error;
+    c->diagnostics_output = NULL;
+
+    if (setjmp(on_error) != 0) {
+        int length = snprintf(result->message, BATCH_MESSAGE_SIZE, "Line %d: %s", c->diagnostics->line, c->diagnostics->message);
+        if (c->error_count > 1 && length < BATCH_MESSAGE_SIZE)
+            snprintf(result->message + length, BATCH_MESSAGE_SIZE - length, " (+%d more errors)", c->error_count - 1);
+    }
+    else if (!open_input(result->path, input_mode))
+        snprintf(result->message, BATCH_MESSAGE_SIZE, "File does not exist");
+    else if (yyparse() != 0 || c->error_count > 0)
+        stop_compilation();
+    else {
+        p = build_program();
+        values* registers = run_program(p, NULL);
+
+        FILE* out = fmemopen(result->message, BATCH_MESSAGE_SIZE, "w");
+        print_value(out, p->result_type, (p->result_type != UNKNOWN_TYPE) ? &registers[p->result] : NULL);
+        fclose(out);
+
+        free(registers);
+        result->success = true;
+    }
+
+    if (p != NULL)
+        free_program(p);
+    close_input();
+    free_compilation(c);
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    result->seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+}
+
+//Return the next file for a thread: from the bottom of its own queue, or else stolen from the top of another one.
+// Return -1 when every queue is empty: no file is added once the batch has started, so the thread can stop
+int take_file(batch* work, int index) {
+    work_queue* own = &work->queues[index];
+    int file = -1;
+
+    pthread_mutex_lock(&own->lock);
+    if (own->top < own->bottom)
+        file = own->files[--own->bottom];
+    pthread_mutex_unlock(&own->lock);
+
+    for (int i=1; file < 0 && i < work->thread_count; i++) {
+        work_queue* victim = &work->queues[(index + i) % work->thread_count];
+        pthread_mutex_lock(&victim->lock);
+        if (victim->top < victim->bottom)
+            file = victim->files[victim->top++];
+        pthread_mutex_unlock(&victim->lock);
+    }
+    return file;
+}
+
+void* run_worker(void* argument) {
+    batch_worker* worker = argument;
+    batch* work = worker->work;
+    int file;
+
+    while ((file = take_file(work, worker->index)) >= 0)
+        compile_file(&work->results[file], work->input_mode);
+
+    arena_free_all();
+    return NULL;
+}
+
+//Compile every file of the batch with 'thread_count' threads (0 for one per core), then print a line per file and a summary.
+// Return 0 if every file was compiled and executed successfully, 1 otherwise
+int run_batch(char* path, int thread_count, int input_mode) {
+    batch work;
+    memset(&work, 0, sizeof(work));
+    work.input_mode = input_mode;
+
+    if (!collect_batch_files(&work, path)) {
+        printf("Cannot read the batch %s\n", path);
+        return 1;
+    }
+
+    if (thread_count <= 0)
+        thread_count = (int) sysconf(_SC_NPROCESSORS_ONLN);
+    if (thread_count > work.count)
+        thread_count = work.count;
+    if (thread_count < 1)
+        thread_count = 1;
+    work.thread_count = thread_count;
+
+    //Each queue starts with a contiguous range of files, so that neighbouring (often similar) files go to the same thread
+    work.queues = calloc(thread_count, sizeof(work_queue));
+    batch_worker* workers = calloc(thread_count, sizeof(batch_worker));
+    int* files = malloc((work.count + 1) * sizeof(int));
+    for (int i=0; i<work.count; i++)
+        files[i] = i;
+    for (int t=0; t<thread_count; t++) {
+        work.queues[t].files = files;
+        work.queues[t].top = (int) ((long) work.count * t / thread_count);
+        work.queues[t].bottom = (int) ((long) work.count * (t + 1) / thread_count);
+        pthread_mutex_init(&work.queues[t].lock, NULL);
+    }
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int t=0; t<thread_count; t++) {
+        workers[t].work = &work;
+        workers[t].index = t;
+        pthread_create(&workers[t].thread, NULL, run_worker, &workers[t]);
+    }
+    for (int t=0; t<thread_count; t++)
+        pthread_join(workers[t].thread, NULL);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    int failed = 0;
+    for (int i=0; i<work.count; i++) {
+        batch_result* result = &work.results[i];
+        printf("%-4s %s: %s (%.3f ms)\n", result->success ? "OK" : "FAIL", result->path, result->message, result->seconds * 1e3);
+        if (!result->success)
+            failed++;
+        free(result->path);
+    }
+
+    double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    printf("\nBatch: %d files, %d succeeded, %d failed, %d threads, %.3f s (%.0f files/s)\n",
+           work.count, work.count - failed, failed, thread_count, seconds, (seconds > 0) ? work.count / seconds : 0);
+
+    for (int t=0; t<thread_count; t++)
+        pthread_mutex_destroy(&work.queues[t].lock);
+    free(files);
+    free(workers);
+    free(work.queues);
+    free(work.results);
+    return (failed > 0) ? 1 : 0;
+}
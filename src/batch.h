@@ -0,0 +1,54 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <pthread.h>
+
+/* Batch driver, selected with --batch: compiles and executes many source files in a single process.
+   Files are split among a pool of threads, each running one compilation at a time in its own context (see compilation.h).
+   Every thread owns a queue of files: it takes them from the bottom, and once its queue is empty it steals from the top
+   of the queues of the other threads, so that threads given short files help the ones given long files */
+
+#define BATCH_MESSAGE_SIZE 256
+
+//Struct holding the outcome of the compilation of one file
+typedef struct batch_result {
+    char* path;
+    bool success;
+    char message[BATCH_MESSAGE_SIZE];   //Value returned by the program, or the error that stopped the compilation
+    double seconds;
+} batch_result;
+
+//Struct defining the queue of files of a thread, as indexes in the batch
+typedef struct work_queue {
+    int* files;
+    int top;                    //First file not taken yet, where other threads steal
+    int bottom;                 //One past the last file not taken yet, where the owner takes
+    pthread_mutex_t lock;
+} work_queue;
+
+//Struct defining a batch: the files to compile, their results, and the queues of the threads
+typedef struct batch {
+    batch_result* results;
+    int count;
+    int capacity;
+    int input_mode;
+    work_queue* queues;
+    int thread_count;
+} batch;
+
+//Struct given to each thread of the pool
+typedef struct batch_worker {
+    batch* work;
+    int index;                  //Queue owned by the thread
+    pthread_t thread;
+} batch_worker;
+
+
+//Function signatures, see batch.c for implementation (build_program in yacc.y)
+
+int run_batch(char* path, int thread_count, int input_mode);
+void compile_file(batch_result* result, int input_mode);
+int yyparse();
+struct program* build_program();
+
+#endif
@@ -0,0 +1,304 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <setjmp.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+#include "bytecode.h"
+#include "compilation.h"
+#include "generator.h"
+#include "token_buffer.h"
+#include "benchmark.h"
+
+/* Scaling benchmark over generated programs. Check structs declaration in benchmark.h */
+
+
+//Compile the file in a new context, up to the given mode, and fill the result. With 'threads' above 0 the input is
+// lexed ahead in parallel (see token_buffer.h). Errors end the compilation without being printed, and leave the result
+// unsuccessful
+void measure_compilation(char* path, int mode, int input_mode, int threads, benchmark_result* result) {
+    struct timespec start, end;
+    jmp_buf on_error;
+    program* volatile p = NULL;
+    long allocations = arena_allocations;
+    long arena_bytes = arena_bytes_allocated;
+
+    compilation* c = create_compilation();
+    c->on_error = &on_error;
+    c->diagnostics_output = NULL;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    if (setjmp(on_error) != 0 || !open_input(path, input_mode))
+        result->success = false;
+    else if (threads > 0 && !lex_in_parallel(threads))
+        result->success = false;
+    else if (mode == BENCHMARK_LEX) {
+        scan_all_tokens();
+        result->success = true;
+    } else if (yyparse() != 0 || c->error_count > 0)
+        stop_compilation();
+    else if (mode == BENCHMARK_PARSE)
+        result->success = true;
+    else {
+        p = build_program();
+        free(run_program(p, NULL));
+        result->success = true;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    result->seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    result->bytes = c->input_bytes;
+    result->tokens = c->stats.tokens;
+    result->allocations = arena_allocations - allocations;
+    result->arena_bytes = arena_bytes_allocated - arena_bytes;
+
+    if (p != NULL)
+        free_program(p);
+    close_input();
+    free_compilation(c);
+}
+
+//Take a measure in a child process, which sends its result through a pipe. The peak memory is read when the child
+// is collected, so it only covers that measure
+benchmark_result run_measure(char* path, int mode, int input_mode, int threads) {
+    benchmark_result result;
+    memset(&result, 0, sizeof(result));
+    int channel[2];
+    struct rusage usage;
+    int status;
+
+    fflush(stdout);
+    if (pipe(channel) != 0)
+        return result;
+    pid_t child = fork();
+    if (child == 0) {
+        close(channel[0]);
+        measure_compilation(path, mode, input_mode, threads, &result);
+        ssize_t written = write(channel[1], &result, sizeof(result));
+        _exit(written == sizeof(result) ? 0 : 1);
+    }
+
+    close(channel[1]);
+    if (child < 0 || read(channel[0], &result, sizeof(result)) != sizeof(result))
+        result.success = false;
+    close(channel[0]);
+    if (child > 0 && wait4(child, &status, 0, &usage) == child)
+        result.peak_rss = usage.ru_maxrss;
+    return result;
+}
+
+//Measure the symbol table with 'count' variables, in a compilation of its own: half of them are declared in the global
+// block and half in a nested one, then looked up from the nested block in an order spread over the whole table
+void measure_symbols(int count, symbol_result* result) {
+    struct timespec start, middle, end;
+    char name[16];
+    long found = 0;
+
+    compilation* c = create_compilation();
+    ident** ids = malloc(count * sizeof(ident*));
+    for (int i = 0; i < count; i++)
+        ids[i] = intern_identifier(name, sprintf(name, "v%d", i));
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int i = 0; i < count; i++) {
+        if (i == count / 2)
+            enter_new_block();
+        elem* element = create_element(ids[i], 1);
+        set_element_type(element, INT_TYPE);
+        insert_element(element);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &middle);
+    for (long i = 0; i < BENCHMARK_LOOKUPS; i++)        //An odd multiplier visits every variable once per 'count' lookups
+        found += lookup_table(c->current_table, ids[(i * 2654435761u) % count], true) != NO_SYMBOL;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    result->symbols = count;
+    result->insert_ns = ((middle.tv_sec - start.tv_sec) * 1e9 + (middle.tv_nsec - start.tv_nsec)) / count;
+    result->lookup_ns = ((end.tv_sec - middle.tv_sec) * 1e9 + (end.tv_nsec - middle.tv_nsec)) / BENCHMARK_LOOKUPS;
+    if (found != BENCHMARK_LOOKUPS)
+        result->lookup_ns = -1;
+    free(ids);
+    free_compilation(c);
+}
+
+//Natural logarithm, computed here so that the build needs no math library
+double natural_log(double x) {
+    double result = 0;
+    for (; x > 2; x /= 2)
+        result += 0.6931471805599453;
+    for (; x < 1; x *= 2)
+        result -= 0.6931471805599453;
+
+    double y = (x - 1) / (x + 1), term = y, sum = 0;      //ln(x) = 2 atanh(y), with y below 1/3
+    for (int n = 1; n < 40; n += 2) {
+        sum += term / n;
+        term *= y * y;
+    }
+    return result + 2 * sum;
+}
+
+//Exponent k such that the quantity grows as size^k, between two measures
+double scaling_exponent(double first, double last, double first_size, double last_size) {
+    if (first <= 0 || last <= 0)
+        return 0;
+    return natural_log(last / first) / natural_log(last_size / first_size);
+}
+
+//Generate programs of growing size from the specification, measure each mode on each of them, and print a table and the
+// growth of every mode. Return 0 if all the measures succeeded and none grows super-linearly, 1 otherwise
+int run_benchmark(char* spec, int input_mode) {
+    static const char* mode_names[] = { "lex", "parse", "full" };
+    generator_options options;
+    benchmark_result results[BENCHMARK_MODES][BENCHMARK_SIZES];
+    int statements[BENCHMARK_SIZES];
+    bool failed = false;
+
+    if (!parse_generator_options(spec, &options)) {
+        printf("Invalid generator options %s\n", spec);
+        return 1;
+    }
+
+    printf("%-6s %10s %10s %9s %10s %12s %11s %10s %11s\n",
+           "Mode", "Statements", "Bytes", "Tokens", "Time (s)", "Tokens/s", "Allocations", "Arena KB", "Peak RSS KB");
+    for (int size = 0; size < BENCHMARK_SIZES; size++) {
+        char path[] = "/tmp/benchmark-XXXXXX.c";
+        int fd = mkstemps(path, 2);
+        FILE* out = (fd >= 0) ? fdopen(fd, "w") : NULL;
+        if (out == NULL) {
+            printf("Cannot create a temporary file\n");
+            return 1;
+        }
+        generate_program(&options, out);
+        fclose(out);
+        statements[size] = options.statements;
+
+        for (int mode = 0; mode < BENCHMARK_MODES; mode++) {
+            benchmark_result* best = &results[mode][size];
+            for (int run = 0; run < BENCHMARK_REPEATS; run++) {
+                benchmark_result result = run_measure(path, mode, input_mode, 0);
+                if (run == 0 || !result.success || result.seconds < best->seconds)
+                    *best = result;
+                if (!result.success)
+                    break;
+            }
+
+            if (!best->success) {
+                printf("%-6s %10d  failed\n", mode_names[mode], statements[size]);
+                failed = true;
+                continue;
+            }
+            printf("%-6s %10d %10ld %9ld %10.4f %12.0f %11ld %10ld %11ld\n", mode_names[mode], statements[size], best->bytes,
+                   best->tokens, best->seconds, best->tokens / best->seconds, best->allocations, best->arena_bytes / 1024, best->peak_rss);
+        }
+        unlink(path);
+
+        options.statements *= 2;
+        options.declarations *= 2;
+    }
+
+    //The symbol table alone, keeping the fastest run of each operation
+    symbol_result tables[BENCHMARK_SIZES];
+    printf("\n%-10s %12s %12s\n", "Symbols", "Insert (ns)", "Lookup (ns)");
+    for (int size = 0; size < BENCHMARK_SIZES; size++) {
+        symbol_result* best = &tables[size];
+        for (int run = 0; run < BENCHMARK_REPEATS; run++) {
+            symbol_result result;
+            measure_symbols(BENCHMARK_SYMBOLS << size, &result);
+            if (run == 0 || result.insert_ns < best->insert_ns)
+                best->insert_ns = result.insert_ns;
+            if (run == 0 || result.lookup_ns < best->lookup_ns)
+                best->lookup_ns = result.lookup_ns;
+            best->symbols = result.symbols;
+        }
+        if (best->lookup_ns < 0) {
+            printf("%-10d  failed\n", best->symbols);
+            failed = true;
+            continue;
+        }
+        printf("%-10d %12.1f %12.1f\n", best->symbols, best->insert_ns, best->lookup_ns);
+    }
+
+    //Growth from the smallest program to the largest, with the size measured in tokens, and of the symbol table with
+    // as many operations as variables
+    if (failed)
+        return 1;
+    printf("\nGrowth from %d to %d statements (exponent of the size, 1 is linear):\n", statements[0], statements[BENCHMARK_SIZES - 1]);
+    for (int mode = 0; mode < BENCHMARK_MODES; mode++) {
+        benchmark_result* first = &results[mode][0];
+        benchmark_result* last = &results[mode][BENCHMARK_SIZES - 1];
+        double time = scaling_exponent(first->seconds, last->seconds, first->tokens, last->tokens);
+        double allocations = scaling_exponent(first->allocations, last->allocations, first->tokens, last->tokens);
+        double memory = scaling_exponent(first->arena_bytes, last->arena_bytes, first->tokens, last->tokens);
+        bool superlinear = time > BENCHMARK_SUPERLINEAR || allocations > BENCHMARK_SUPERLINEAR || memory > BENCHMARK_SUPERLINEAR;
+
+        printf("  %-6s time %.2f, allocations %.2f, arena memory %.2f%s\n", mode_names[mode], time, allocations, memory,
+               superlinear ? "  SUPER-LINEAR" : "");
+        failed |= superlinear;
+    }
+
+    symbol_result* first = &tables[0];
+    symbol_result* last = &tables[BENCHMARK_SIZES - 1];
+    double inserts = scaling_exponent(first->insert_ns * first->symbols, last->insert_ns * last->symbols, first->symbols, last->symbols);
+    double lookups = scaling_exponent(first->lookup_ns * first->symbols, last->lookup_ns * last->symbols, first->symbols, last->symbols);
+    bool superlinear = inserts > BENCHMARK_SUPERLINEAR || lookups > BENCHMARK_SUPERLINEAR;
+    printf("  %-6s insertions %.2f, lookups %.2f (from %d to %d variables)%s\n", "table", inserts, lookups, first->symbols,
+           last->symbols, superlinear ? "  SUPER-LINEAR" : "");
+    failed |= superlinear;
+    return failed ? 1 : 0;
+}
+
+//Generate a program from the specification and lex it without threads, then in parallel with more and more threads,
+// printing the throughput and the speedup over the scanner alone. The input is mapped in memory, as parallel lexing
+// requires. Return 0 if all the measures succeeded, 1 otherwise
+int run_lex_benchmark(char* spec) {
+    static const int thread_counts[BENCHMARK_LEX_RUNS] = { 0, 1, 2, 4, 8 };
+    generator_options options;
+    double serial = 0;
+    bool failed = false;
+
+    if (!parse_generator_options(spec, &options)) {
+        printf("Invalid generator options %s\n", spec);
+        return 1;
+    }
+    char path[] = "/tmp/benchmark-XXXXXX.c";
+    int fd = mkstemps(path, 2);
+    FILE* out = (fd >= 0) ? fdopen(fd, "w") : NULL;
+    if (out == NULL) {
+        printf("Cannot create a temporary file\n");
+        return 1;
+    }
+    generate_program(&options, out);
+    fclose(out);
+
+    printf("%ld cores online\n", sysconf(_SC_NPROCESSORS_ONLN));
+    printf("%-8s %10s %9s %10s %8s %12s %8s %11s\n", "Threads", "Bytes", "Tokens", "Time (s)", "MB/s", "Tokens/s", "Speedup", "Peak RSS KB");
+    for (int run = 0; run < BENCHMARK_LEX_RUNS; run++) {
+        benchmark_result best;
+        for (int repeat = 0; repeat < BENCHMARK_REPEATS; repeat++) {
+            benchmark_result result = run_measure(path, BENCHMARK_LEX, INPUT_MMAP, thread_counts[run]);
+            if (repeat == 0 || !result.success || result.seconds < best.seconds)
+                best = result;
+            if (!result.success)
+                break;
+        }
+
+        char threads[16];
+        if (thread_counts[run] == 0)
+            strcpy(threads, "scanner");
+        else
+            snprintf(threads, sizeof(threads), "%d", thread_counts[run]);
+        if (!best.success) {
+            printf("%-8s  failed\n", threads);
+            failed = true;
+            continue;
+        }
+        if (run == 0)
+            serial = best.seconds;
+        printf("%-8s %10ld %9ld %10.4f %8.1f %12.0f %7.2fx %11ld\n", threads, best.bytes, best.tokens, best.seconds,
+               best.bytes / best.seconds / 1e6, best.tokens / best.seconds, (serial > 0) ? serial / best.seconds : 0, best.peak_rss);
+    }
+    unlink(path);
+    return failed ? 1 : 0;
+}
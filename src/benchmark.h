@@ -0,0 +1,56 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <stdbool.h>
+
+/* Scaling benchmark, selected with --benchmark: programs of growing size are generated (see generator.h) and compiled
+   lexing only, parsing only, and through execution. Every measure runs in a child process, so that the peak memory of
+   each one is its own, and the growth of time and allocations from the smallest program to the largest is reported as
+   an exponent of the size: about 1 for linear work, flagged when it goes beyond BENCHMARK_SUPERLINEAR.
+   The symbol table is measured on its own as well, with more and more variables: the time of each insertion and of each
+   lookup should stay flat as the tables grow.
+   With --benchmark-lex, a single generated program is lexed by the scanner alone and then in parallel (see token_buffer.h)
+   with a growing number of threads, to show how the throughput scales */
+
+#define BENCHMARK_SIZES 5               //Programs measured, each twice the size of the previous one
+#define BENCHMARK_REPEATS 3             //Runs of each measure, the fastest is kept
+#define BENCHMARK_SUPERLINEAR 1.3       //Exponent above which the growth is reported as super-linear
+
+#define BENCHMARK_LEX 0
+#define BENCHMARK_PARSE 1
+#define BENCHMARK_FULL 2
+#define BENCHMARK_MODES 3
+
+#define BENCHMARK_LEX_RUNS 5            //Lexing without threads, then with 1, 2, 4 and 8 of them
+
+#define BENCHMARK_SYMBOLS 4096          //Variables of the smallest symbol table measured, doubled for each size
+#define BENCHMARK_LOOKUPS (1 << 22)     //Lookups timed on each symbol table
+
+//Struct holding one measure, sent back by the child process that took it
+typedef struct benchmark_result {
+    bool success;
+    double seconds;
+    long bytes;
+    long tokens;
+    long allocations;           //Arena allocations (see arena.h)
+    long arena_bytes;
+    long peak_rss;              //In KB, of the whole child process
+} benchmark_result;
+
+//Struct holding the cost of the symbol table operations with a given number of variables
+typedef struct symbol_result {
+    int symbols;
+    double insert_ns;           //Per insertion, the check for a variable with the same name in the block included
+    double lookup_ns;           //Per lookup, from the innermost block
+} symbol_result;
+
+
+//Function signatures, see benchmark.c for implementation (scan_all_tokens and build_program in yacc.y)
+
+int run_benchmark(char* spec, int input_mode);
+int run_lex_benchmark(char* spec);
+long scan_all_tokens();
+int yyparse();
+struct program* build_program();
+
+#endif
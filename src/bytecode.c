@@ -0,0 +1,426 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bytecode.h"
+#include "compilation.h"
+#include "operators.h"
+
+/* Translation of the abstract syntax tree into bytecode. Check structs declaration in bytecode.h */
+
+#define OPCODE_NAME(name, format) #name,
+#define OPCODE_FORMAT(name, format) format,
+const char* opcode_names[] = { OPCODES(OPCODE_NAME) };
+const char* opcode_formats[] = { OPCODES(OPCODE_FORMAT) };
+
+
+//Add an instruction at the end of the program, and return its position
+int emit(program* p, int op, int a, int b, int c, int line_number) {
+    if (p->length == p->capacity) {
+        p->capacity = (p->capacity == 0) ? 64 : p->capacity * 2;
+        p->code = realloc(p->code, p->capacity * sizeof(instr));
+        p->lines = realloc(p->lines, p->capacity * sizeof(int));
+    }
+
+    instr* i = &p->code[p->length];
+    i->op = op;
+    i->a = a;
+    i->b = b;
+    i->c = c;
+    p->lines[p->length] = line_number;
+
+    return p->length++;
+}
+
+//Set the destination of a jump emitted before its target was known
+void patch_jump(program* p, int position, int target) {
+    if (p->code[position].op == OP_JMP)
+        p->code[position].a = target;
+    else
+        p->code[position].b = target;
+}
+
+//Add a value to the constants of the program. Since constant registers are placed after the temporaries,
+// whose number is known only at the end, the constant is referred to with a negative index until then (see remap_constants)
+int add_constant(program* p, values* value, int type) {
+    if (p->constant_count == p->constant_capacity) {
+        p->constant_capacity = (p->constant_capacity == 0) ? 16 : p->constant_capacity * 2;
+        p->constants = realloc(p->constants, p->constant_capacity * sizeof(values));
+        p->constant_types = realloc(p->constant_types, p->constant_capacity * sizeof(int));
+    }
+
+    p->constants[p->constant_count] = *value;
+    p->constant_types[p->constant_count] = type;
+
+    return -1 - p->constant_count++;
+}
+
+//Replace the negative constant indexes with the actual registers, once the number of temporaries is known
+void remap_constants(program* p) {
+    for (int i=0; i<p->length; i++) {
+        const char* format = opcode_formats[p->code[i].op];
+        int* operands[3] = { &p->code[i].a, &p->code[i].b, &p->code[i].c };
+
+        for (int j=0; j<3; j++)
+            if (format[j] == 'r' && *operands[j] < 0)
+                *operands[j] = p->constant_base - 1 - *operands[j];
+    }
+
+    if (p->result_type != UNKNOWN_TYPE && p->result < 0)
+        p->result = p->constant_base - 1 - p->result;
+}
+
+int new_temp() {
+    int temp = context->next_temp++;
+    if (context->next_temp > context->max_temp)
+        context->max_temp = context->next_temp;
+
+    return temp;
+}
+
+//Emit the instructions computing an expression, and return the register holding the result.
+// If 'target' is a register, the result is written directly there when possible (e.g. 'i = i + 1' becomes one instruction)
+int compile_expression(program* p, node* n, int target) {
+    int saved_temp = context->next_temp;
+    int first, second, result;
+
+    switch(n->kind) {
+        case NODE_CONSTANT:
+            return add_constant(p, &n->value, n->type);
+        case NODE_VARIABLE:
+            return n->slot;
+        case NODE_CONVERT:
+            first = compile_expression(p, n->left, -1);
+            context->next_temp = saved_temp;         //The operand is not needed after this instruction, so its register can be reused
+            result = (target >= 0) ? target : new_temp();
+            emit(p, OP_I2F, result, first, 0, n->line_number);
+            return result;
+        case NODE_OPERATION:
+            first = compile_expression(p, n->left, -1);
+            second = (n->right != NULL) ? compile_expression(p, n->right, -1) : 0;
+            context->next_temp = saved_temp;
+            result = (target >= 0) ? target : new_temp();
+            emit(p, get_operator_rule(n->op, n->left->type, n->left->type)->opcode, result, first, second, n->line_number);    //Operands have the same type
+            return result;
+        default:
+            fatal_error("Unexpected node %d in expression", n->kind);
+            return 0;
+    }
+}
+
+void compile_statement(program* p, node* n);
+
+//Add an empty jump table to the program, and return its index
+int add_switch_table(program* p, int low, int count) {
+    if (p->table_count == p->table_capacity) {
+        p->table_capacity = (p->table_capacity == 0) ? 4 : p->table_capacity * 2;
+        p->tables = realloc(p->tables, p->table_capacity * sizeof(switch_table));
+    }
+
+    switch_table* t = &p->tables[p->table_count];
+    t->low = low;
+    t->count = count;
+    t->targets = malloc(count * sizeof(int));
+    for (int k=0; k<count; k++)
+        t->targets[k] = -1;
+    t->default_target = -1;
+
+    return p->table_count++;
+}
+
+//Emit a jump to the body of a case (-1 for the default), to be patched once the bodies are placed
+void emit_case_jump(switch_lowering* s, int op, int condition, int case_index) {
+    int position = emit(s->p, op, (op == OP_JMP) ? -1 : condition, -1, 0, s->line_number);
+    s->pending[2 * s->pending_count] = position;
+    s->pending[2 * s->pending_count + 1] = case_index;
+    s->pending_count++;
+}
+
+//Emit the comparison 'scrutinee <operation> key', and return the register of its result
+int emit_key_comparison(switch_lowering* s, case_key* k, int operation) {
+    values value = k->c->left->value;
+    if (k->type == REAL_TYPE)
+        value.f = (float) k->real;              //The constant may be an INT converted to REAL
+    int constant = add_constant(s->p, &value, k->type);
+    int result = new_temp();
+    emit(s->p, get_operator_rule(operation, k->type, k->type)->opcode, result, s->scrutinee, constant, k->c->line_number);
+    return result;
+}
+
+//Emit a balanced binary search for the scrutinee among the sorted keys [first, last): the half holding it is chosen
+// with one comparison, until few enough keys are left to compare them one by one
+void emit_case_search(switch_lowering* s, int first, int last) {
+    int saved_temp = context->next_temp;
+
+    if (last - first <= SWITCH_LINEAR_CASES) {
+        for (int k=first; k<last; k++) {
+            emit_case_jump(s, OP_JNZ, emit_key_comparison(s, &s->keys[k], EQUAL), s->keys[k].index);
+            context->next_temp = saved_temp;
+        }
+        emit_case_jump(s, OP_JMP, 0, -1);
+        return;
+    }
+
+    int middle = (first + last) / 2;
+    int jump = emit(s->p, OP_JNZ, emit_key_comparison(s, &s->keys[middle], SMALLER), -1, 0, s->line_number);
+    context->next_temp = saved_temp;
+    emit_case_search(s, middle, last);
+    patch_jump(s->p, jump, s->p->length);
+    emit_case_search(s, first, middle);
+}
+
+//Emit a jump table on the value of an INT or CHAR scrutinee. Its targets are the indexes of the cases until patched
+void emit_case_table(switch_lowering* s, int count, int type) {
+    int low = (int) s->keys[0].integer;
+    int table = add_switch_table(s->p, low, (int) (s->keys[count - 1].integer - low + 1));
+
+    for (int k=0; k<count; k++)
+        s->p->tables[table].targets[s->keys[k].integer - low] = s->keys[k].index;
+    emit(s->p, (type == CHAR_TYPE) ? OP_SWITCH_C : OP_SWITCH_I, s->scrutinee, table, 0, s->line_number);
+}
+
+//Emit a jump table on the hash of a STRING scrutinee, followed by the comparisons of each bucket.
+// Interned strings are equal only if they are the same pointer, so each comparison is a single instruction
+void emit_case_hash(switch_lowering* s, int count) {
+    int buckets = 1;
+    while (buckets < count)
+        buckets *= 2;
+    int table = add_switch_table(s->p, 0, buckets);
+    emit(s->p, OP_SWITCH_S, s->scrutinee, table, 0, s->line_number);
+
+    int* heads = malloc(buckets * sizeof(int));         //Keys of each bucket, linked through 'next'
+    int* next = malloc(count * sizeof(int));
+    for (int b=0; b<buckets; b++)
+        heads[b] = -1;
+    for (int k=count - 1; k>=0; k--) {
+        int b = STRING_HEADER(s->keys[k].c->left->value.s)->hash & (buckets - 1);
+        next[k] = heads[b];
+        heads[b] = k;
+    }
+
+    for (int b=0; b<buckets; b++) {
+        int saved_temp = context->next_temp;
+        if (heads[b] < 0)
+            continue;
+
+        s->p->tables[table].targets[b] = s->p->length;
+        for (int k=heads[b]; k>=0; k=next[k]) {
+            emit_case_jump(s, OP_JNZ, emit_key_comparison(s, &s->keys[k], EQUAL), s->keys[k].index);
+            context->next_temp = saved_temp;
+        }
+        emit_case_jump(s, OP_JMP, 0, -1);
+    }
+
+    free(heads);
+    free(next);
+}
+
+//Translate a switch: the dispatch to the cases, then their bodies in source order, each one ending with a break, then the default.
+// With enough cases, all compared with a variable of their own type, the dispatch is a jump table for dense INT and CHAR values,
+// a binary search for the other INT, CHAR and REAL ones, and a hash table for strings. Otherwise each case is tested in order
+void compile_switch(program* p, node* n) {
+    int count = 0, saved_temp = context->next_temp;
+    for (node* c = n->first; c != NULL; c = c->next)
+        count++;
+
+    switch_lowering s;
+    s.p = p;
+    s.scrutinee = compile_expression(p, n->init, -1);
+    s.line_number = n->line_number;
+    s.keys = malloc(count * sizeof(case_key));
+    s.pending = malloc((4 * count + 2) * sizeof(int));
+    s.pending_count = 0;
+
+    int type = n->init->type;
+    bool lowered = count >= SWITCH_MIN_CASES && n->init->kind == NODE_VARIABLE && get_case_keys(n->first, s.keys) == count;
+    for (int k=0; lowered && k<count; k++)
+        lowered = s.keys[k].type == type;
+    int table = -1;
+
+    if (lowered && type == STRING_TYPE) {
+        emit_case_hash(&s, count);
+        table = p->table_count - 1;
+    } else if (lowered && (type == INT_TYPE || type == CHAR_TYPE)
+               && s.keys[count - 1].integer - s.keys[0].integer < (long) SWITCH_TABLE_DENSITY * count) {
+        emit_case_table(&s, count, type);
+        table = p->table_count - 1;
+    } else if (lowered && type != BOOL_TYPE)
+        emit_case_search(&s, 0, count);
+    else {
+        int index = 0;
+        for (node* c = n->first; c != NULL; c = c->next, index++) {
+            emit_case_jump(&s, OP_JNZ, compile_expression(p, c->condition, -1), index);
+            context->next_temp = saved_temp;
+        }
+        emit_case_jump(&s, OP_JMP, 0, -1);    //No case matched: go to default
+    }
+
+    int* positions = malloc((count + 1) * sizeof(int));     //Start of each body, the default being the last one
+    int* breaks = malloc(count * sizeof(int));
+    int index = 0;
+    for (node* c = n->first; c != NULL; c = c->next, index++) {
+        positions[index] = p->length;
+        compile_statement(p, c->body);
+        breaks[index] = emit(p, OP_JMP, -1, 0, 0, c->line_number);
+    }
+    positions[count] = p->length;
+    if (n->else_body != NULL)
+        compile_statement(p, n->else_body);
+
+    for (int i=0; i<count; i++)
+        patch_jump(p, breaks[i], p->length);
+    for (int i=0; i<s.pending_count; i++) {
+        int target = s.pending[2 * i + 1];
+        patch_jump(p, s.pending[2 * i], positions[(target < 0) ? count : target]);
+    }
+    if (table >= 0) {
+        switch_table* t = &p->tables[table];
+        t->default_target = positions[count];
+        for (int k=0; k<t->count; k++) {
+            if (t->targets[k] < 0)
+                t->targets[k] = positions[count];
+            else if (type != STRING_TYPE)       //Hash tables already hold the positions of their buckets
+                t->targets[k] = positions[t->targets[k]];
+        }
+    }
+
+    free(s.keys);
+    free(s.pending);
+    free(positions);
+    free(breaks);
+}
+
+void compile_statement(program* p, node* n) {
+    int saved_temp = context->next_temp;
+    int value, condition, jump, start;
+    node* c;
+
+    switch(n->kind) {
+        case NODE_BLOCK:
+            for (c = n->first; c != NULL; c = c->next)
+                compile_statement(p, c);
+            break;
+
+        case NODE_ASSIGN:
+            value = compile_expression(p, n->left, n->slot);
+            if (value != n->slot)
+                emit(p, OP_MOV, n->slot, value, 0, n->line_number);
+            break;
+
+        case NODE_IF:                   //  JZ cond, else; body; JMP end; else: else_body; end:
+            condition = compile_expression(p, n->condition, -1);
+            jump = emit(p, OP_JZ, condition, -1, 0, n->line_number);
+            context->next_temp = saved_temp;
+            compile_statement(p, n->body);
+
+            if (n->else_body != NULL) {
+                start = emit(p, OP_JMP, -1, 0, 0, n->line_number);
+                patch_jump(p, jump, p->length);
+                compile_statement(p, n->else_body);
+                jump = start;
+            }
+            patch_jump(p, jump, p->length);
+            break;
+
+        case NODE_WHILE:                //  JMP test; body: body; test: JNZ cond, body
+        case NODE_FOR:                  //The test is at the bottom, so each iteration executes a single jump
+            if (n->init != NULL)
+                compile_statement(p, n->init);
+            jump = emit(p, OP_JMP, -1, 0, 0, n->line_number);
+            start = p->length;
+            compile_statement(p, n->body);
+            if (n->step != NULL)
+                compile_statement(p, n->step);
+
+            patch_jump(p, jump, p->length);
+            condition = compile_expression(p, n->condition, -1);
+            emit(p, OP_JNZ, condition, start, 0, n->line_number);
+            break;
+
+        case NODE_SWITCH:
+            compile_switch(p, n);
+            break;
+    }
+
+    context->next_temp = saved_temp;     //Temporaries never live across statements
+}
+
+//Translate the whole program: 'body' contains the statements, 'result' is the returned expression (NULL for 'return;')
+//Record the registers of the STRING variables: the ones of the global symbols, and the ones released by the closed blocks,
+// which were never given to a variable of another type
+void collect_string_registers(program* p) {
+    symbol_store* symbols = &context->symbols;
+    slot_pool* released = &symbols->free_slots[STRING_TYPE];
+
+    p->string_registers = malloc((symbols->count + released->count + 1) * sizeof(int));
+    for (int s=0; s<symbols->count; s++)
+        if (symbols->types[s] == STRING_TYPE)
+            p->string_registers[p->string_register_count++] = symbols->slots[s];
+    for (int i=0; i<released->count; i++)
+        p->string_registers[p->string_register_count++] = released->slots[i];
+    p->empty_string = intern_string("", 0);
+}
+
+program* compile_program(node* body, node* result) {
+    program* p = calloc(1, sizeof(program));
+    p->variable_count = context->slot_count;
+    context->next_temp = context->slot_count;
+    context->max_temp = context->slot_count;
+
+    compile_statement(p, body);
+
+    p->result_type = UNKNOWN_TYPE;
+    if (result != NULL) {
+        p->result = compile_expression(p, result, -1);
+        p->result_type = result->type;
+    }
+    emit(p, OP_RET, 0, 0, 0, context->number_line);
+
+    p->constant_base = context->max_temp;
+    p->register_count = context->max_temp + p->constant_count;
+    remap_constants(p);
+    collect_string_registers(p);
+
+    return p;
+}
+
+void free_program(program* p) {
+    free(p->code);
+    free(p->string_registers);
+    free(p->lines);
+    free(p->constants);
+    free(p->constant_types);
+    for (int i=0; i<p->table_count; i++)
+        free(p->tables[i].targets);
+    free(p->tables);
+    free(p->threaded);
+    free(p);
+}
+
+//Print the instructions of the program, in verbose mode
+void print_program(program* p) {
+    if (verbose == true) {
+        printf(" -------------\n  Registers: %d (variables: %d, constants from r%d)\n", p->register_count, p->variable_count, p->constant_base);
+
+        for (int i=0; i<p->length; i++) {
+            const char* format = opcode_formats[p->code[i].op];
+            int operands[3] = { p->code[i].a, p->code[i].b, p->code[i].c };
+
+            printf("  %4d  Line %3d  %-8s", i, p->lines[i], opcode_names[p->code[i].op] + 3);     //Skip the "OP_" prefix
+            for (int j=0; j<3; j++) {
+                if (format[j] == 'r')
+                    printf(" r%d", operands[j]);
+                else if (format[j] == 'j')
+                    printf(" @%d", operands[j]);
+                else if (format[j] == 't') {        //Targets of the table, from its lowest value (or first bucket)
+                    switch_table* t = &p->tables[operands[j]];
+                    printf(" [%d:", t->low);
+                    for (int k=0; k<t->count; k++)
+                        printf(" @%d", t->targets[k]);
+                    printf("] else @%d", t->default_target);
+                }
+            }
+            printf("\n");
+        }
+        printf(" -------------\n");
+    }
+}
@@ -0,0 +1,127 @@
+#ifndef BYTECODE_H
+#define BYTECODE_H
+
+/* Register-based bytecode executed by the virtual machine in vm.c.
+   Every declared variable, temporary and constant of the program lives in a register (a 'values' slot):
+    - registers [0, variable_count) hold the variables, at the slot assigned by the symbol table
+    - registers [variable_count, constant_base) hold the temporaries of the expressions
+    - registers [constant_base, register_count) hold the constants, loaded before the execution starts
+   Instructions are typed, so no type check is performed while running */
+
+//List of the opcodes with their operands format: 'r' register, 'j' jump target, 't' switch table, '-' unused.
+// The list is expanded with different definitions of X to build the enum, the names and the interpreter labels
+#define OPCODES(X)                                                            \
+    X(OP_MOV, "rr-")    X(OP_I2F, "rr-")                                      \
+    X(OP_ADD_I, "rrr")  X(OP_SUB_I, "rrr")  X(OP_MUL_I, "rrr")                \
+    X(OP_DIV_I, "rrr")  X(OP_MOD_I, "rrr")                                    \
+    X(OP_ADD_F, "rrr")  X(OP_SUB_F, "rrr")  X(OP_MUL_F, "rrr")                \
+    X(OP_DIV_F, "rrr")                                                        \
+    X(OP_AND, "rrr")    X(OP_OR, "rrr")     X(OP_NOT, "rr-")                  \
+    X(OP_EQ_I, "rrr")   X(OP_GE_I, "rrr")   X(OP_LE_I, "rrr")                 \
+    X(OP_GT_I, "rrr")   X(OP_LT_I, "rrr")                                     \
+    X(OP_EQ_F, "rrr")   X(OP_GE_F, "rrr")   X(OP_LE_F, "rrr")                 \
+    X(OP_GT_F, "rrr")   X(OP_LT_F, "rrr")                                     \
+    X(OP_EQ_C, "rrr")   X(OP_GE_C, "rrr")   X(OP_LE_C, "rrr")                 \
+    X(OP_GT_C, "rrr")   X(OP_LT_C, "rrr")                                     \
+    X(OP_EQ_B, "rrr")   X(OP_GE_B, "rrr")   X(OP_LE_B, "rrr")                 \
+    X(OP_GT_B, "rrr")   X(OP_LT_B, "rrr")                                     \
+    X(OP_EQ_S, "rrr")   X(OP_GE_S, "rrr")   X(OP_LE_S, "rrr")                 \
+    X(OP_GT_S, "rrr")   X(OP_LT_S, "rrr")                                     \
+    X(OP_JMP, "j--")    X(OP_JZ, "rj-")     X(OP_JNZ, "rj-")                  \
+    X(OP_SWITCH_I, "rt-") X(OP_SWITCH_C, "rt-") X(OP_SWITCH_S, "rt-")         \
+    X(OP_RET, "---")
+
+#define OPCODE_ENUM(name, format) name,
+enum opcode { OPCODES(OPCODE_ENUM) OPCODE_COUNT };
+
+
+//Struct defining one instruction: 'a' is the destination (or the tested register for conditional jumps),
+// 'b' and 'c' the operands (or the jump target)
+typedef struct instr {
+    int op;
+    int a;
+    int b;
+    int c;
+} instr;
+
+//Struct defining the jump table of a switch instruction. OP_SWITCH_I and OP_SWITCH_C jump to entry v - low for the value v,
+// if it is in the table. OP_SWITCH_S jumps to the entry of the string's bucket, its hash modulo 'count' (a power of 2),
+// where the cases with that hash are compared one by one. Other values go to default_target
+typedef struct switch_table {
+    int low;
+    int count;
+    int* targets;
+    int default_target;
+} switch_table;
+
+//Struct defining a compiled program
+typedef struct program {
+    instr* code;
+    int* lines;             //Source line of each instruction, used in runtime errors
+    int length;
+    int capacity;
+
+    values* constants;      //Initial content of the constant registers
+    int* constant_types;    //Data type of each constant
+    int constant_count;
+    int constant_capacity;
+
+    int variable_count;
+    int constant_base;
+    int register_count;
+
+    int* string_registers;  //Registers of the STRING variables, which hold the empty string until they are assigned
+    int string_register_count;
+    char* empty_string;     //Interned "", the initial content of those registers
+
+    switch_table* tables;   //Jump tables of the switch instructions, one each
+    int table_count;
+    int table_capacity;
+
+    int result;             //Register holding the value returned by the program, -1 if it returns nothing
+    int result_type;
+
+    void* threaded;         //Instructions translated for the direct-threaded interpreter (see vm.c), NULL until the first execution
+} program;
+
+
+// Lowering of switch statements (see compile_switch)
+#define SWITCH_MIN_CASES 4          //Switches with fewer cases compare the scrutinee with each case in order
+#define SWITCH_TABLE_DENSITY 2      //A jump table may have up to this many entries per case, else cases are searched
+#define SWITCH_LINEAR_CASES 3       //Cases compared one by one at the leaves of the binary search
+
+//Struct holding the state of the lowering of one switch: the jumps to a case are emitted before its position is known,
+// and patched once the bodies are placed
+typedef struct switch_lowering {
+    program* p;
+    int scrutinee;          //Register of the scrutinee
+    int line_number;
+    case_key* keys;         //Cases sorted by value
+    int* pending;           //Pairs (position of the jump, index of the case or -1 for default)
+    int pending_count;
+} switch_lowering;
+
+
+// Output requested with --emit
+#define EMIT_NONE 0         //Execute the program with the virtual machine
+#define EMIT_ASM 1          //Write x86-64 assembly
+#define EMIT_OBJECT 2       //Write an ELF object
+
+
+//Function signatures, see bytecode.c, optimize.c, vm.c and native.c for implementation
+
+struct execution_profile;
+
+program* compile_program(node* body, node* result);
+void free_program(program* p);
+void print_program(program* p);
+node* optimize_tree(node* body, node* result);
+int optimize_program(program* p);
+values* run_program(program* p, struct execution_profile* profile);
+void clear_registers(program* p, values* regs);
+int run_registers(program* p, values* regs);
+int interpret(program* p, values* regs, struct execution_profile* profile);
+void emit_assembly(program* p, FILE* out);
+int write_object(program* p, char* path);
+
+#endif
@@ -0,0 +1,760 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "cache.h"
+#include "trace.h"
+#include "compilation.h"
+#include "diagnostics.h"
+#include "keywords.h"
+
+/* Incremental compilation with a cache of the checked regions. Check structs declaration in cache.h
+   A cache file holds a header, the entries (key, position, length and checksum of the data) and then the data of each
+   region, in the byte order of the machine:
+     - length of the effects, followed by the effects: registers and size of the global table after the region,
+       variables declared in the global table (name, type, width, register, initialized, line) and
+       variables of the global table assigned for the first time (name)
+     - tree of the region, in preorder. Lines are stored relative to the first line of the region,
+       so that a region moved by an edit above it is still found */
+
+#define FNV_OFFSET_BASIS 14695981039346656037ull
+#define FNV_PRIME 1099511628211ull
+
+
+//FNV-1a hash of 'length' bytes, continuing from 'seed' (FNV_OFFSET_BASIS to start a new hash)
+uint64_t hash_bytes(const void* data, size_t length, uint64_t seed) {
+    const unsigned char* bytes = data;
+    uint64_t hash = seed;
+
+    for (size_t i=0; i<length; i++) {
+        hash ^= bytes[i];
+        hash *= FNV_PRIME;
+    }
+    return hash;
+}
+
+// Functions splitting the source into regions
+//-------------------------------------------------------------------------------------
+
+//Skip spaces, newlines and comments starting at 'i', counting the lines. Return the position of the next character
+size_t skip_blanks(const char* text, size_t length, size_t i, int* line) {
+    while (i < length) {
+        if (text[i] == '/' && i+1 < length && text[i+1] == '/') {
+            while (i < length && text[i] != '\n')
+                i++;
+            continue;
+        }
+        if (text[i] == '\n')
+            (*line)++;
+        else if (text[i] != ' ' && text[i] != '\t' && text[i] != '\r' && text[i] != '\f')
+            break;
+        i++;
+    }
+    return i;
+}
+
+//Check whether the text at position 'i' is the given word, not followed by other characters of an identifier
+bool starts_with_word(const char* text, size_t length, size_t i, const char* word) {
+    size_t word_length = strlen(word);
+    if (i + word_length > length || strncmp(text + i, word, word_length) != 0)
+        return false;
+    return i + word_length == length || !(isalnum((unsigned char) text[i + word_length]) || text[i + word_length] == '_');
+}
+
+//Return the kind of the region starting at position 'i', or 0 if no region can start there
+int region_kind(const char* text, size_t length, size_t i) {
+    if (i >= length || !(isalpha((unsigned char) text[i]) || text[i] == '_'))
+        return 0;
+    size_t end = i;
+    while (end < length && (isalnum((unsigned char) text[end]) || text[end] == '_'))
+        end++;
+
+    const keyword* k = find_keyword(text + i, (int) (end - i));     //Same table as the scanner (see keywords.c)
+    if (k == NULL)
+        return REGION_STATEMENT;        //Assignment
+    switch (k->token) {
+        case INT: case FLOAT: case CHAR: case BOOL:     //"char*" starts with "char"
+            return REGION_DECLARATION;
+        case RETURN:
+            return REGION_RETURN;
+        case IF: case WHILE: case FOR: case SWITCH:
+            return REGION_STATEMENT;
+        default:
+            return 0;
+    }
+}
+
+//Split the source into regions, up to the return statement: the parser ignores what follows it.
+// A declaration ends with its ';', a statement with its ';' or with the '}' closing its last block (unless an else follows).
+// Return false if the source does not have the structure expected by the grammar (declarations, statements and
+// a return statement, with balanced brackets): it is then parsed as a whole, so that the errors are reported as usual
+bool split_regions(const char* text, size_t length, region** regions, int* count) {
+    int capacity = 64;
+    int found = 0;
+    int line = 1;
+    bool statements_seen = false;
+    region* list = malloc(capacity * sizeof(region));
+
+    size_t i = skip_blanks(text, length, 0, &line);
+    while (i < length) {
+        region r = { text + i, 0, line, region_kind(text, length, i) };
+        if (r.kind == 0 || (r.kind == REGION_DECLARATION && statements_seen))
+            break;
+        statements_seen = statements_seen || r.kind == REGION_STATEMENT;
+
+        int braces = 0;
+        int parens = 0;
+        bool complete = false;
+        while (i < length && !complete && braces >= 0 && parens >= 0) {
+            char c = text[i++];
+            if (c == '\n')
+                line++;
+            else if (c == '/' && i < length && text[i] == '/') {
+                while (i < length && text[i] != '\n')
+                    i++;
+            } else if (c == '"') {              //Strings and characters may contain brackets and semicolons
+                while (i < length && text[i] != '"')
+                    line += (text[i++] == '\n');
+                i += (i < length);
+            } else if (c == '\'' && i+1 < length && text[i+1] == '\'')
+                i += 2;
+            else if (c == '(')
+                parens++;
+            else if (c == ')')
+                parens--;
+            else if (c == '{')
+                braces++;
+            else if (c == '}' && --braces == 0 && parens == 0) {
+                int next_line = line;
+                complete = !starts_with_word(text, length, skip_blanks(text, length, i, &next_line), "else");
+            } else if (c == ';' && braces == 0 && parens == 0)
+                complete = true;
+        }
+        if (!complete)
+            break;
+
+        r.length = (int) (text + i - r.text);
+        if (found == capacity) {
+            capacity *= 2;
+            list = realloc(list, capacity * sizeof(region));
+        }
+        list[found++] = r;
+
+        if (r.kind == REGION_RETURN) {
+            *regions = list;
+            *count = found;
+            return true;
+        }
+        i = skip_blanks(text, length, i, &line);
+    }
+
+    free(list);
+    return false;
+}
+
+// Functions writing and reading the data of the regions
+//-------------------------------------------------------------------------------------
+
+void put_bytes(cache_buffer* out, const void* data, size_t length) {
+    if (out->length + length > out->capacity) {
+        out->capacity = (out->capacity == 0) ? 4096 : out->capacity;
+        while (out->length + length > out->capacity)
+            out->capacity *= 2;
+        out->data = realloc(out->data, out->capacity);
+    }
+    memcpy(out->data + out->length, data, length);
+    out->length += length;
+}
+
+void put_int(cache_buffer* out, int32_t value) {
+    put_bytes(out, &value, sizeof(value));
+}
+
+//Write a string preceded by its length, -1 for NULL
+void put_string(cache_buffer* out, const char* text) {
+    int32_t length = (text != NULL) ? (int32_t) strlen(text) : -1;
+    put_int(out, length);
+    if (length > 0)
+        put_bytes(out, text, length);
+}
+
+//Return a pointer to the next 'length' bytes, or NULL if the data is shorter
+const char* get_bytes(cache_reader* in, size_t length) {
+    if (in->failed || length > in->length - in->position) {
+        in->failed = true;
+        return NULL;
+    }
+    const char* bytes = in->data + in->position;
+    in->position += length;
+    return bytes;
+}
+
+int32_t get_int(cache_reader* in) {
+    int32_t value = 0;
+    const char* bytes = get_bytes(in, sizeof(value));
+    if (bytes != NULL)
+        memcpy(&value, bytes, sizeof(value));
+    return value;
+}
+
+//Read an integer that has to be in [low, high), marking the data as damaged otherwise. Return 'low' for damaged data
+int32_t get_int_in(cache_reader* in, int32_t low, int32_t high) {
+    int32_t value = get_int(in);
+    if (value < low || value >= high)
+        in->failed = true;
+    return in->failed ? low : value;
+}
+
+//Read a string written by put_string, without copying it. Return NULL for a NULL string
+const char* get_string(cache_reader* in, int* length) {
+    *length = get_int(in);
+    if (*length < 0)
+        return NULL;
+    const char* text = get_bytes(in, *length);
+    if (text == NULL)
+        *length = -1;
+    return text;
+}
+
+//Read a string written by put_string, copying it in the memory of the compilation
+char* copy_string(cache_reader* in) {
+    int length;
+    const char* text = get_string(in, &length);
+    return (text != NULL) ? arena_strndup(&context->memory, text, length) : NULL;
+}
+
+//Write the content of a constant. Only the field corresponding to its type is kept
+void write_value(cache_buffer* out, int type, values* value) {
+    switch (type) {
+        case INT_TYPE:
+            put_int(out, value->i);
+            break;
+        case REAL_TYPE:
+            put_bytes(out, &value->f, sizeof(value->f));
+            break;
+        case CHAR_TYPE:
+            put_int(out, value->c);
+            break;
+        case BOOL_TYPE:
+            put_int(out, value->b);
+            break;
+        case STRING_TYPE:
+            put_string(out, value->s);
+            break;
+    }
+}
+
+void read_value(cache_reader* in, int type, values* value) {
+    const char* bytes;
+    int length;
+    switch (type) {
+        case INT_TYPE:
+            value->i = get_int(in);
+            break;
+        case REAL_TYPE:
+            if ((bytes = get_bytes(in, sizeof(value->f))) != NULL)
+                memcpy(&value->f, bytes, sizeof(value->f));
+            break;
+        case CHAR_TYPE:
+            value->c = (char) get_int(in);
+            break;
+        case BOOL_TYPE:
+            value->b = get_int(in);
+            break;
+        case STRING_TYPE:
+            if ((bytes = get_string(in, &length)) != NULL)
+                value->s = intern_string(bytes, length);
+            break;
+    }
+}
+
+//Write a tree in preorder: the fields of the node, its children, then the statements of its list (if any).
+// A NULL child is written as kind 0
+void write_node(cache_buffer* out, node* n, int line) {
+    if (n == NULL) {
+        put_int(out, 0);
+        return;
+    }
+    put_int(out, n->kind);
+    put_int(out, n->type);
+    put_int(out, n->op);
+    put_int(out, n->line_number - line);
+    put_int(out, n->number);
+    put_int(out, n->slot);
+    put_string(out, n->name);
+    if (n->kind == NODE_CONSTANT)
+        write_value(out, n->type, &n->value);
+
+    node* children[] = { n->left, n->right, n->condition, n->body, n->else_body, n->init, n->step };
+    for (int i=0; i<7; i++)
+        write_node(out, children[i], line);
+
+    int count = 0;
+    for (node* statement = n->first; statement != NULL; statement = statement->next)
+        count++;
+    put_int(out, count);
+    for (node* statement = n->first; statement != NULL; statement = statement->next)
+        write_node(out, statement, line);
+}
+
+//Rebuild a tree written by write_node, for a region starting at the given line. Kinds, types, operators and registers
+// out of range mark the data as damaged, so that they never reach the checker and the translation
+node* read_node(cache_reader* in, int line) {
+    int kind = get_int_in(in, 0, NODE_ERROR + 1);
+    if (kind == 0)
+        return NULL;
+
+    int type = get_int_in(in, 0, TYPE_COUNT);
+    int op = get_int(in);
+    if (kind == NODE_OPERATION && (op < PLUS || op >= PLUS + OPERATOR_COUNT))
+        in->failed = true;
+    int line_offset = get_int(in);
+    int number = get_int(in);
+    int slot = get_int_in(in, -1, in->slot_count);
+    if (in->failed)
+        return NULL;
+
+    node* n = create_node(kind, type, 0);
+    n->op = op;
+    n->line_number = line + line_offset;
+    n->number = number;
+    n->slot = slot;
+    n->name = copy_string(in);
+    if (kind == NODE_CONSTANT)
+        read_value(in, type, &n->value);
+
+    n->left = read_node(in, line);
+    n->right = read_node(in, line);
+    n->condition = read_node(in, line);
+    n->body = read_node(in, line);
+    n->else_body = read_node(in, line);
+    n->init = read_node(in, line);
+    n->step = read_node(in, line);
+
+    int count = get_int(in);
+    for (int i=0; i<count && !in->failed; i++)
+        append_statement(n, read_node(in, line));
+    return n;
+}
+
+//Write the effects of a region on the global table, given the first symbol it could have declared there.
+// The effects are then added to the state, so that the following regions are looked up with the new global table
+void write_effects(region_cache* cache, region* r, int first_declared) {
+    symbol_store* symbols = &context->symbols;
+    cache_buffer* out = &cache->data;
+    uint64_t length = 0;
+    put_bytes(out, &length, sizeof(length));        //Filled at the end
+    size_t start = out->length;
+
+    put_int(out, context->slot_count);
+    put_int(out, context->global_table->offset);
+
+    put_int(out, context->global_table->count - first_declared);
+    for (int symbol = first_declared; symbol < context->global_table->count; symbol++) {
+        put_string(out, symbols->ids[symbol]->name);
+        put_int(out, symbols->types[symbol]);
+        put_int(out, symbols->widths[symbol]);
+        put_int(out, symbols->slots[symbol]);
+        put_int(out, symbols->initialized[symbol]);
+        put_int(out, symbols->lines[symbol] - r->line);
+    }
+
+    put_int(out, cache->assigned_count);
+    for (int i=0; i<cache->assigned_count; i++)
+        put_string(out, symbols->ids[cache->assigned[i]]->name);
+
+    put_int(out, context->stats.frame_size);
+    for (int type = 0; type < TYPE_COUNT; type++) {         //Registers freed by the blocks of the region and of the ones before
+        slot_pool* pool = &symbols->free_slots[type];
+        put_int(out, pool->count);
+        for (int i=0; i<pool->count; i++)
+            put_int(out, pool->slots[i]);
+    }
+
+    length = out->length - start;
+    memcpy(out->data + start - sizeof(length), &length, sizeof(length));
+    cache->state = hash_bytes(out->data + start, length, cache->state);
+}
+
+//Read the effects written by write_effects, checking that types and registers are in range. Only if 'apply' is set,
+// apply them to the global table and add them to the state: the data of a region is first read without applying
+// anything, so that a damaged region leaves the global table untouched
+void read_effects(region_cache* cache, cache_reader* in, region* r, bool apply) {
+    symbol_store* symbols = &context->symbols;
+    uint64_t length = 0;
+    const char* bytes = get_bytes(in, sizeof(length));
+    if (bytes != NULL)
+        memcpy(&length, bytes, sizeof(length));
+    if (in->failed || length > in->length - in->position) {
+        in->failed = true;
+        return;
+    }
+    if (apply)
+        cache->state = hash_bytes(in->data + in->position, length, cache->state);
+
+    int slot_count = get_int_in(in, 0, INT_MAX);
+    int offset = get_int_in(in, 0, INT_MAX);
+    in->slot_count = slot_count;
+
+    int count = get_int_in(in, 0, INT_MAX);
+    for (int i=0; i<count && !in->failed; i++) {
+        int name_length;
+        const char* name = get_string(in, &name_length);
+        int type = get_int_in(in, 0, TYPE_COUNT);
+        int width = get_int_in(in, 0, INT_MAX);
+        int slot = get_int_in(in, 0, slot_count);
+        int initialized = get_int(in);
+        int line = r->line + get_int(in);
+        if (name == NULL)
+            in->failed = true;
+        if (!apply || in->failed)
+            continue;
+
+        elem* el = create_element(intern_identifier((char*) name, name_length), 0);
+        el->type = type;
+        el->width = width;
+        int symbol = insert_element(el);
+        if (symbol != NO_SYMBOL) {
+            symbols->slots[symbol] = slot;      //Registers are assigned in parsing order, including the ones of nested blocks
+            symbols->initialized[symbol] = initialized;
+            symbols->lines[symbol] = line;
+        }
+    }
+
+    count = get_int_in(in, 0, INT_MAX);
+    for (int i=0; i<count && !in->failed; i++) {
+        int name_length;
+        const char* name = get_string(in, &name_length);
+        if (name == NULL)
+            in->failed = true;
+        if (!apply || in->failed)
+            continue;
+        int symbol = lookup_table(context->global_table, intern_identifier((char*) name, name_length), false);
+        if (symbol != NO_SYMBOL)
+            symbols->initialized[symbol] = true;
+    }
+
+    int frame_size = get_int_in(in, 0, INT_MAX);
+    if (apply && frame_size > context->stats.frame_size)
+        context->stats.frame_size = frame_size;
+    for (int type = 0; type < TYPE_COUNT && !in->failed; type++) {     //Inserting the symbols took registers from the pools:
+        if (apply)                                                      // they are replaced by the ones of the region
+            symbols->free_slots[type].count = 0;
+        int free_count = get_int_in(in, 0, INT_MAX);
+        for (int i=0; i<free_count && !in->failed; i++) {
+            int slot = get_int_in(in, 0, slot_count);
+            if (apply && !in->failed)
+                release_slot(type, slot);
+        }
+    }
+
+    if (apply) {
+        context->slot_count = slot_count;
+        context->global_table->offset = offset;
+    }
+}
+
+// Functions managing the cache file
+//-------------------------------------------------------------------------------------
+
+//Return the path of the cache file of a source: the hash of its absolute path, in the cache directory
+char* cache_file_path(char* source, char* directory) {
+    char absolute[PATH_MAX];
+    if (realpath(source, absolute) == NULL)
+        snprintf(absolute, sizeof(absolute), "%s", source);
+    mkdir(directory, 0777);         //Failures are reported when the file is written
+
+    size_t size = strlen(directory) + 32;
+    char* path = malloc(size);
+    snprintf(path, size, "%s/%016llx.cache", directory, (unsigned long long) hash_bytes(absolute, strlen(absolute), FNV_OFFSET_BASIS));
+    return path;
+}
+
+//Map the cache file written by the previous compilation and index its entries.
+// Return false if there is no usable file: missing, damaged, or written by a different version
+bool load_cache(region_cache* cache) {
+    struct stat info;
+    int fd = open(cache->path, O_RDONLY);
+    if (fd < 0)
+        return false;
+    if (fstat(fd, &info) != 0 || info.st_size < (off_t) sizeof(cache_header)) {
+        close(fd);
+        return false;
+    }
+    char* mapped = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED)
+        return false;
+
+    cache_header* header = (cache_header*) mapped;
+    size_t entries_size = (size_t) header->count * sizeof(cache_entry);
+    if (memcmp(header->magic, CACHE_MAGIC, sizeof(header->magic)) != 0 || header->version != CACHE_VERSION ||
+        entries_size > (size_t) info.st_size || sizeof(cache_header) + entries_size + header->data_size != (size_t) info.st_size) {
+        munmap(mapped, info.st_size);
+        return false;
+    }
+
+    cache->mapped = mapped;
+    cache->mapped_length = info.st_size;
+    cache->entries = (cache_entry*) (mapped + sizeof(cache_header));
+    cache->entries_data = mapped + sizeof(cache_header) + entries_size;
+
+    cache->index_capacity = 16;
+    while (cache->index_capacity < 2 * (int) header->count)      //Keep the load factor below 50%
+        cache->index_capacity *= 2;
+    cache->index = malloc(cache->index_capacity * sizeof(int));
+    memset(cache->index, -1, cache->index_capacity * sizeof(int));
+
+    for (int i=0; i<(int) header->count; i++) {
+        cache_entry* entry = &cache->entries[i];
+        if (entry->offset > header->data_size || entry->length > header->data_size - entry->offset)
+            continue;
+        int pos = entry->key & (cache->index_capacity - 1);
+        while (cache->index[pos] != -1)
+            pos = (pos + 1) & (cache->index_capacity - 1);
+        cache->index[pos] = i;
+    }
+    return true;
+}
+
+//Return the entry of the previous cache file with the given key, or NULL
+cache_entry* find_entry(region_cache* cache, uint64_t key) {
+    if (cache->index == NULL)
+        return NULL;
+
+    int pos = key & (cache->index_capacity - 1);
+    while (cache->index[pos] != -1) {
+        if (cache->entries[cache->index[pos]].key == key)
+            return &cache->entries[cache->index[pos]];
+        pos = (pos + 1) & (cache->index_capacity - 1);
+    }
+    return NULL;
+}
+
+//Add to the next cache file the region whose data starts at 'offset' in the new data. Return false if the key is already
+// there (the same text with the same global table): the data is then dropped
+bool add_entry(region_cache* cache, uint64_t key, size_t offset) {
+    if (2 * (cache->new_count + 1) > cache->new_keys_capacity) {        //Grow the set of keys, keeping the load factor below 50%
+        cache->new_keys_capacity = (cache->new_keys_capacity == 0) ? 64 : cache->new_keys_capacity * 2;
+        free(cache->new_keys);
+        cache->new_keys = calloc(cache->new_keys_capacity, sizeof(uint64_t));
+        for (int i=0; i<cache->new_count; i++) {
+            int pos = cache->new_entries[i].key & (cache->new_keys_capacity - 1);
+            while (cache->new_keys[pos] != 0)
+                pos = (pos + 1) & (cache->new_keys_capacity - 1);
+            cache->new_keys[pos] = cache->new_entries[i].key;
+        }
+    }
+
+    int pos = key & (cache->new_keys_capacity - 1);
+    while (cache->new_keys[pos] != 0) {         //Zero marks an empty bucket: a key equal to zero is simply never stored
+        if (cache->new_keys[pos] == key) {
+            cache->data.length = offset;
+            return false;
+        }
+        pos = (pos + 1) & (cache->new_keys_capacity - 1);
+    }
+    if (key == 0) {
+        cache->data.length = offset;
+        return false;
+    }
+    cache->new_keys[pos] = key;
+
+    if (cache->new_count == cache->new_capacity) {
+        cache->new_capacity = (cache->new_capacity == 0) ? 64 : cache->new_capacity * 2;
+        cache->new_entries = realloc(cache->new_entries, cache->new_capacity * sizeof(cache_entry));
+    }
+    cache_entry* entry = &cache->new_entries[cache->new_count++];
+    entry->key = key;
+    entry->offset = offset;
+    entry->length = cache->data.length - offset;
+    entry->checksum = hash_bytes(cache->data.data + offset, entry->length, FNV_OFFSET_BASIS);
+    return true;
+}
+
+//Write the next cache file. It is written aside and then renamed, so that a compilation never sees a partial file
+void save_cache(region_cache* cache) {
+    char temporary[PATH_MAX];
+    snprintf(temporary, sizeof(temporary), "%s.%d.tmp", cache->path, (int) getpid());
+
+    FILE* out = fopen(temporary, "wb");
+    if (out == NULL) {
+        fprintf(stderr, "Cannot write the cache to %s\n", cache->path);
+        return;
+    }
+
+    cache_header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, CACHE_MAGIC, sizeof(header.magic));
+    header.version = CACHE_VERSION;
+    header.count = cache->new_count;
+    header.data_size = cache->data.length;
+
+    bool written = fwrite(&header, sizeof(header), 1, out) == 1 &&
+                   fwrite(cache->new_entries, sizeof(cache_entry), cache->new_count, out) == (size_t) cache->new_count &&
+                   fwrite(cache->data.data, 1, cache->data.length, out) == cache->data.length;
+    written = (fclose(out) == 0) && written;
+
+    if (!written || rename(temporary, cache->path) != 0) {
+        fprintf(stderr, "Cannot write the cache to %s\n", cache->path);
+        remove(temporary);
+    }
+}
+
+//Release the cache, including the mapping of the previous file
+void free_cache(region_cache* cache) {
+    if (cache->mapped != NULL)
+        munmap(cache->mapped, cache->mapped_length);
+    free(cache->index);
+    free(cache->data.data);
+    free(cache->new_entries);
+    free(cache->new_keys);
+    free(cache->assigned);
+    free(cache->path);
+}
+
+// Functions compiling the regions
+//-------------------------------------------------------------------------------------
+
+//Record that a variable received its first value. Called by the parser only while the cache is used:
+// variables of the global table are part of the effects of the region (see write_effects)
+void note_first_assignment(int symbol) {
+    region_cache* cache = context->cache;
+    if (symbol >= context->global_table->count)        //Symbols of the nested blocks follow the global ones
+        return;
+
+    if (cache->assigned_count == cache->assigned_capacity) {
+        cache->assigned_capacity = (cache->assigned_capacity == 0) ? 16 : cache->assigned_capacity * 2;
+        cache->assigned = realloc(cache->assigned, cache->assigned_capacity * sizeof(int));
+    }
+    cache->assigned[cache->assigned_count++] = symbol;
+}
+
+//Lex, parse and check a region. If it contains no errors, its data is added to the next cache file
+node* parse_region(region_cache* cache, uint64_t key, region* r) {
+    int first_global = context->global_table->count;
+    int errors = context->error_count;
+    int result;
+
+    cache->assigned_count = 0;
+    context->region_tree = NULL;
+    open_region(r->text, r->length, r->line);
+    {
+        ENTER_PHASE(PHASE_PARSE);
+        result = yyparse();
+        LEAVE_PHASE();
+    }
+    close_region();
+
+    size_t offset = cache->data.length;
+    write_effects(cache, r, first_global);
+    if (result == 0 && context->error_count == errors) {
+        write_node(&cache->data, context->region_tree, r->line);
+        add_entry(cache, key, offset);
+    } else
+        cache->data.length = offset;        //The effects are still part of the state, but the region is not stored
+
+    return context->region_tree;
+}
+
+//Rebuild a region from the previous cache file into 'tree', and copy its data to the next one. The data is checked first,
+// against its checksum and then by reading it without applying the effects. Return false, without changing the global
+// table, if it is damaged: the region is then compiled as if it was not in the cache
+bool restore_region(region_cache* cache, uint64_t key, cache_entry* entry, region* r, node** tree) {
+    cache_reader in = { cache->entries_data + entry->offset, entry->length, 0, false, 0 };
+
+    bool intact = hash_bytes(in.data, in.length, FNV_OFFSET_BASIS) == entry->checksum;
+    if (intact) {
+        read_effects(cache, &in, r, false);
+        *tree = read_node(&in, r->line);
+    }
+    if (!intact || in.failed) {
+        PRINT_VERBOSE("Region at line %d is damaged in the cache, compiling it again", r->line);
+        return false;
+    }
+    in.position = 0;
+    read_effects(cache, &in, r, true);
+
+    size_t offset = cache->data.length;
+    put_bytes(&cache->data, in.data, in.length);
+    add_entry(cache, key, offset);
+
+    PRINT_VERBOSE("Region at line %d reused from the cache", r->line);
+    return true;
+}
+
+//Compile a source file reusing the regions found in the cache directory, and update the cache if no error was found.
+// On return, the global table and the tree of the program are the same that yyparse would have built.
+// Sources that cannot be split into regions (see split_regions) are parsed as a whole. Return the result of yyparse
+int parse_with_cache(char* source, int mode, char* directory) {
+    ENTER_PHASE(PHASE_CACHE);
+    struct stat info;
+    char* text = MAP_FAILED;
+    region* regions = NULL;
+    int count = 0;
+
+    int fd = open(source, O_RDONLY);
+    if (fd >= 0 && fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0)
+        text = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (fd >= 0)
+        close(fd);
+
+    if (text == MAP_FAILED || !split_regions(text, info.st_size, &regions, &count)) {
+        if (text != MAP_FAILED)
+            munmap(text, info.st_size);
+        LEAVE_PHASE();
+        set_input_source(source, mode);
+        return yyparse();
+    }
+    printf("Reading file...\n");
+
+    region_cache cache;
+    memset(&cache, 0, sizeof(cache));
+    cache.path = cache_file_path(source, directory);
+    cache.state = FNV_OFFSET_BASIS;
+    load_cache(&cache);
+    context->cache = &cache;
+
+    node* body = make_block_node();
+    node* result = NULL;
+    int parsed = 0;
+
+    for (int i=0; i<count; i++) {
+        region* r = &regions[i];
+        uint64_t key = hash_bytes(r->text, r->length, cache.state);
+        cache_entry* entry = find_entry(&cache, key);
+
+        node* tree;
+        if (entry != NULL && restore_region(&cache, key, entry, r, &tree))
+            context->stats.cache_reused++;
+        else {
+            tree = parse_region(&cache, key, r);
+            parsed++;
+        }
+        context->stats.cache_regions++;
+
+        if (r->kind == REGION_RETURN)
+            result = tree;
+        else if (r->kind == REGION_DECLARATION && tree != NULL)
+            append_block(body, tree);
+        else
+            append_statement(body, tree);
+    }
+
+    context->program_body = body;
+    context->program_result = result;
+    if (parsed > 0 && context->error_count == 0)    //When every region was reused, the previous file has all of them already
+        save_cache(&cache);
+
+    context->cache = NULL;
+    free_cache(&cache);
+    free(regions);
+    munmap(text, info.st_size);
+    LEAVE_PHASE();
+    return 0;
+}
@@ -0,0 +1,102 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+/* Incremental compilation, selected with --cache-dir.
+   The source is split into regions: each top-level declaration, each top-level statement (with all the blocks nested
+   in it) and the return statement. A region is identified by the hash of its text and of the state of the global table
+   when it starts. After a compilation without errors, the checked tree of every region is written to a binary file of
+   the cache directory, together with the effects of the region on the global table (variables declared or assigned for
+   the first time, registers used). On the next compilation of the same file the cache file is mapped in memory, and
+   the regions found there are rebuilt from it without being lexed, parsed and checked again: after an edit, only the
+   regions whose text changed, or which see a different global table, are compiled. The data of a region is checked
+   before it is used (checksum, then kinds, types and registers in range), and a damaged region is compiled again.
+   Optimization and translation to bytecode always work on the whole tree */
+
+#define CACHE_MAGIC "CCCACHE"   //First bytes of a cache file, including the final zero
+#define CACHE_VERSION 3         //To be incremented whenever the format of the data changes
+
+// Kinds of region
+#define REGION_DECLARATION 1
+#define REGION_STATEMENT 2
+#define REGION_RETURN 3
+
+//Struct defining a region of the source
+typedef struct region {
+    const char* text;           //First character of the region, inside the source mapped in memory
+    int length;
+    int line;                   //Line of the first character
+    int kind;                   //From the above define list
+} region;
+
+//Header of a cache file. It is followed by 'count' entries and by the data of the regions
+typedef struct cache_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t count;
+    uint64_t data_size;
+} cache_header;
+
+//Struct locating the data of a region in a cache file
+typedef struct cache_entry {
+    uint64_t key;               //Hash of the text of the region and of the state of the global table
+    uint64_t offset;            //Position of the data, from the beginning of the data section
+    uint64_t length;
+    uint64_t checksum;          //Hash of the data, compared before the region is rebuilt
+} cache_entry;
+
+//Growable buffer, collecting the data of the next cache file
+typedef struct cache_buffer {
+    char* data;
+    size_t length;
+    size_t capacity;
+} cache_buffer;
+
+//Cursor reading the data of one region
+typedef struct cache_reader {
+    const char* data;
+    size_t length;
+    size_t position;
+    bool failed;                //Set when a read goes past the end or a value is out of range: the cache file is damaged
+    int slot_count;             //Registers of the program after the region, read from its effects: bound of the ones in its tree
+} cache_reader;
+
+//Struct holding the cache of the file being compiled (see 'cache' in compilation.h)
+typedef struct region_cache {
+    char* path;                     //Cache file of the source
+    char* mapped;                   //Cache file written by the previous compilation, mapped in memory (NULL if missing)
+    size_t mapped_length;
+    cache_entry* entries;           //Entries of the previous cache file, inside the mapping
+    const char* entries_data;
+    int* index;                     //Open-addressing hash table of the entries, by key (-1 for empty buckets)
+    int index_capacity;
+
+    cache_buffer data;              //Data of the next cache file
+    cache_entry* new_entries;
+    int new_count;
+    int new_capacity;
+    uint64_t* new_keys;             //Open-addressing set of the keys already in new_entries, to store each region once
+    int new_keys_capacity;
+
+    int* assigned;                  //Symbols of the global table assigned for the first time in the region being parsed
+    int assigned_count;
+    int assigned_capacity;
+    uint64_t state;                 //Hash of the effects of all the regions so far, identifying the global table
+} region_cache;
+
+
+//Function signatures, see cache.c for implementation (set_input_source in yacc.y)
+
+int parse_with_cache(char* source, int mode, char* directory);
+bool split_regions(const char* text, size_t length, region** regions, int* count);
+uint64_t hash_bytes(const void* data, size_t length, uint64_t seed);
+void note_first_assignment(int symbol);
+bool load_cache(region_cache* cache);
+void save_cache(region_cache* cache);
+void set_input_source(char* path, int mode);
+int yyparse();
+
+#endif
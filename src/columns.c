@@ -0,0 +1,523 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "bytecode.h"
+#include "compilation.h"
+#include "columns.h"
+
+/* Evaluation of the program over the rows of an input table. Check structs declaration in columns.h */
+
+//Vector types used by run_vectorized: 8 lanes of 4 bytes, one value of a register per lane.
+// With the default target GCC splits each operation in two SSE instructions, with AVX2 it uses a single one
+#if defined(__GNUC__) && !defined(NO_SIMD)
+#define LANES 8
+typedef uint32_t int_lanes __attribute__((vector_size(32), may_alias));
+typedef int32_t signed_lanes __attribute__((vector_size(32), may_alias));
+typedef float real_lanes __attribute__((vector_size(32), may_alias));
+#define TO_REAL(x) __builtin_convertvector(x, real_lanes)
+#else
+#define LANES 1
+typedef uint32_t int_lanes;
+typedef int32_t signed_lanes;
+typedef float real_lanes;
+#define TO_REAL(x) ((real_lanes) (x))
+#endif
+
+//Compile the kernel for AVX2 and for the baseline x86-64, picking the best one when the program starts. Not under
+// ThreadSanitizer: the resolver picking the clone runs before its runtime is started, and would crash the program
+#if defined(__GNUC__) && defined(__x86_64__) && !defined(NO_SIMD) && !defined(__SANITIZE_THREAD__)
+#define SIMD_CLONES __attribute__((target_clones("avx2", "default")))
+#else
+#define SIMD_CLONES
+#endif
+
+_Static_assert(COLUMN_BATCH % LANES == 0, "A batch must fill whole vectors");
+
+
+// Input
+//-------------------------------------------------------------------------------------
+
+//Split the header line into the names of the columns, separated by commas
+void read_column_names(column_input* in, const char* header, size_t length) {
+    int capacity = 4;
+    in->names = malloc(capacity * sizeof(char*));
+    in->count = 0;
+
+    size_t start = 0;
+    while (start <= length) {
+        size_t end = start;
+        while (end < length && header[end] != ',')
+            end++;
+
+        size_t first = start, last = end;                   //Spaces around the name are ignored
+        while (first < last && (header[first] == ' ' || header[first] == '\t'))
+            first++;
+        while (last > first && (header[last - 1] == ' ' || header[last - 1] == '\t' || header[last - 1] == '\r'))
+            last--;
+
+        if (in->count == capacity) {
+            capacity *= 2;
+            in->names = realloc(in->names, capacity * sizeof(char*));
+        }
+        in->names[in->count++] = strndup(header + first, last - first);
+        start = end + 1;
+    }
+
+    in->slots = malloc(in->count * sizeof(int));
+    in->types = malloc(in->count * sizeof(int));
+    for (int column = 0; column < in->count; column++) {
+        in->slots[column] = -1;
+        in->types[column] = UNKNOWN_TYPE;
+    }
+}
+
+//Open the input of column mode, and read the names of its columns. It must be called before parsing, since
+// the declarations of the program are bound to the columns as they are parsed. Return false if it cannot be read.
+// A binary file has the header line of a CSV file, followed by the columns one after the other: each of them is
+// an array of 4-byte values in the byte order of the machine (int, float, 0 or 1 for bool, the code of a char)
+bool open_columns(char* path, int format) {
+    column_input* in = calloc(1, sizeof(column_input));
+    in->path = path;
+    in->format = format;
+
+    if (format == COLUMNS_CSV) {
+        in->file = fopen(path, "r");
+        ssize_t length = (in->file != NULL) ? getline(&in->line, &in->line_capacity, in->file) : -1;
+        if (length < 0) {
+            if (in->file != NULL)
+                fclose(in->file);
+            free(in->line);
+            free(in);
+            return false;
+        }
+        while (length > 0 && (in->line[length - 1] == '\n' || in->line[length - 1] == '\r'))
+            length--;
+        read_column_names(in, in->line, length);
+    } else {
+        int descriptor = open(path, O_RDONLY);
+        struct stat info;
+        if (descriptor < 0 || fstat(descriptor, &info) != 0 || info.st_size == 0) {
+            if (descriptor >= 0)
+                close(descriptor);
+            free(in);
+            return false;
+        }
+        in->mapped_length = info.st_size;
+        in->mapped = mmap(NULL, in->mapped_length, PROT_READ, MAP_PRIVATE, descriptor, 0);
+        close(descriptor);
+        if (in->mapped == MAP_FAILED) {
+            free(in);
+            return false;
+        }
+
+        char* newline = memchr(in->mapped, '\n', in->mapped_length);
+        size_t header_length = (newline != NULL) ? (size_t) (newline - in->mapped) : in->mapped_length;
+        read_column_names(in, in->mapped, header_length);
+        in->data_offset = (newline != NULL) ? header_length + 1 : in->mapped_length;
+
+        size_t row_size = in->count * sizeof(uint32_t);
+        size_t data_length = in->mapped_length - in->data_offset;
+        if (data_length % row_size != 0) {
+            close_columns_input(in);
+            return false;
+        }
+        in->row_count = data_length / row_size;
+    }
+
+    context->columns = in;
+    return true;
+}
+
+//Bind a variable just declared to the column with its name, if there is one. Only variables of the global block
+// can be bound. Return true if the variable was bound: it gets its values from the column, so it counts as initialized
+bool bind_column(int symbol) {
+    column_input* in = context->columns;
+    if (in == NULL || context->current_table != context->global_table)
+        return false;
+
+    symbol_store* symbols = &context->symbols;
+    for (int column = 0; column < in->count; column++) {
+        if (strcmp(in->names[column], symbols->ids[symbol]->name) != 0)
+            continue;
+
+        int type = symbols->types[symbol];
+        if (type == STRING_TYPE || type == ERROR_TYPE) {
+            if (type == STRING_TYPE)
+                yyerror("Column %s cannot be bound to a variable of type string", in->names[column]);
+            return false;
+        }
+        in->slots[column] = symbols->slots[symbol];
+        in->types[column] = type;
+        symbols->initialized[symbol] = true;
+        return true;
+    }
+    return false;
+}
+
+//Convert the text of a field into the 4-byte value of a column of the given type.
+// Return the end of the value, or NULL if the text is not a value of that type
+const char* parse_field(const char* field, int type, uint32_t* lane) {
+    char* end = (char*) field;
+    switch (type) {
+        case INT_TYPE: {
+            int32_t value = (int32_t) strtol(field, &end, 10);
+            memcpy(lane, &value, sizeof(value));
+            break;
+        }
+        case REAL_TYPE: {
+            float value = strtof(field, &end);
+            memcpy(lane, &value, sizeof(value));
+            break;
+        }
+        case BOOL_TYPE:
+            if (strncmp(field, "true", 4) == 0 || strncmp(field, "false", 5) == 0) {
+                *lane = (field[0] == 't');
+                end += (field[0] == 't') ? 4 : 5;
+            } else if (field[0] == '0' || field[0] == '1') {
+                *lane = (field[0] == '1');
+                end++;
+            }
+            break;
+        case CHAR_TYPE:
+            if (field[0] != '\0' && field[0] != ',' && field[0] != '\n') {
+                *lane = (uint32_t) (int32_t) field[0];      //Chars are signed, like in the registers of the virtual machine
+                end++;
+            }
+            break;
+        default:                //Column not bound to any variable: skip it
+            end += strcspn(field, ",\r\n");
+            return end;
+    }
+
+    while (*end == ' ' || *end == '\t')
+        end++;
+    return (end == field) ? NULL : end;
+}
+
+//Read the next rows of the input, up to COLUMN_BATCH, into 'buffer': the values of column c are at
+// buffer[c * COLUMN_BATCH]. Only the columns bound to a variable are read. Return the number of rows read
+int read_rows(column_input* in, uint32_t* buffer) {
+    int rows = 0;
+
+    if (in->format == COLUMNS_BINARY) {
+        rows = (in->row_count - in->next_row < COLUMN_BATCH) ? in->row_count - in->next_row : COLUMN_BATCH;
+        for (int column = 0; column < in->count; column++)
+            if (in->slots[column] >= 0) {
+                const char* data = in->mapped + in->data_offset + (column * in->row_count + in->next_row) * sizeof(uint32_t);
+                memcpy(buffer + column * COLUMN_BATCH, data, rows * sizeof(uint32_t));
+            }
+        in->next_row += rows;
+        return rows;
+    }
+
+    while (rows < COLUMN_BATCH && getline(&in->line, &in->line_capacity, in->file) >= 0) {
+        const char* field = in->line;
+        if (field[strspn(field, " \t\r\n")] == '\0')       //Empty lines are skipped
+            continue;
+
+        in->next_row++;
+        for (int column = 0; column < in->count; column++) {
+            while (*field == ' ' || *field == '\t')
+                field++;
+            const char* end = parse_field(field, in->types[column], &buffer[column * COLUMN_BATCH + rows]);
+            bool last = (column == in->count - 1);
+
+            if (end == NULL || (!last && *end != ',') || (last && *end != '\0' && *end != '\r' && *end != '\n'))
+                fatal_error("Wrong value for column %s in row %ld of %s", in->names[column], in->next_row, in->path);
+            field = end + 1;
+        }
+        rows++;
+    }
+    return rows;
+}
+
+
+// Evaluation
+//-------------------------------------------------------------------------------------
+
+//Value of a register, as stored in a 4-byte lane
+uint32_t lane_of_value(int type, values value) {
+    uint32_t lane = 0;
+    switch (type) {
+        case INT_TYPE:  memcpy(&lane, &value.i, sizeof(lane)); break;
+        case REAL_TYPE: memcpy(&lane, &value.f, sizeof(lane)); break;
+        case BOOL_TYPE: lane = value.b; break;
+        case CHAR_TYPE: lane = (uint32_t) (int32_t) value.c; break;
+    }
+    return lane;
+}
+
+//Value of a register, from a 4-byte lane
+values value_of_lane(int type, uint32_t lane) {
+    values value;
+    memset(&value, 0, sizeof(value));
+    switch (type) {
+        case INT_TYPE:  memcpy(&value.i, &lane, sizeof(lane)); break;
+        case REAL_TYPE: memcpy(&value.f, &lane, sizeof(lane)); break;
+        case BOOL_TYPE: value.b = (lane != 0); break;
+        case CHAR_TYPE: value.c = (char) lane; break;
+    }
+    return value;
+}
+
+//Write the result of one row
+void write_result(FILE* out, int type, values* value) {
+    switch (type) {
+        case INT_TYPE:    fprintf(out, "%d\n", value->i); break;
+        case REAL_TYPE:   fprintf(out, "%f\n", value->f); break;
+        case CHAR_TYPE:   fputc(value->c, out); fputc('\n', out); break;
+        case STRING_TYPE: fputs(value->s, out); fputc('\n', out); break;
+        case BOOL_TYPE:   fputs(value->b ? "true\n" : "false\n", out); break;
+    }
+}
+
+//Stop at a division by 0, reporting the row of the input
+void row_error(program* p, int position, long row) {
+    char message[64];
+    snprintf(message, sizeof(message), "Division by 0 in row %ld", row);
+    runtime_error(p, position, message);
+}
+
+//Whether each instruction can be applied to a whole batch: there are no jumps, since rows could take different paths,
+// and no strings, which do not fit in a lane
+bool can_vectorize(program* p) {
+    if (p->result_type == STRING_TYPE)
+        return false;
+    for (int i = 0; i < p->length; i++) {
+        int op = p->code[i].op;
+        if (is_jump(op) || (op >= OP_EQ_S && op <= OP_LT_S))
+            return false;
+    }
+    for (int k = 0; k < p->constant_count; k++)
+        if (p->constant_types[k] == STRING_TYPE)
+            return false;
+    return true;
+}
+
+//Evaluate the rows of a batch one at a time with the virtual machine, writing their results.
+// 'regs' hold the constants, the other registers are cleared before each row as for a new execution (see clear_registers)
+void evaluate_rows(program* p, values* regs, uint32_t* buffer, int count, FILE* out) {
+    column_input* in = context->columns;
+    long first_row = in->next_row - count + 1;
+
+    for (int k = 0; k < count; k++) {
+        clear_registers(p, regs);
+        for (int column = 0; column < in->count; column++)
+            if (in->slots[column] >= 0)
+                regs[in->slots[column]] = value_of_lane(in->types[column], buffer[column * COLUMN_BATCH + k]);
+
+        int failed = run_registers(p, regs);
+        if (failed >= 0)
+            row_error(p, failed, first_row + k);
+        write_result(out, p->result_type, &regs[p->result]);
+    }
+}
+
+//Apply each instruction to the first 'count' rows of a batch before moving to the next one. Register r holds the
+// values of the rows in lanes[r * COLUMN_BATCH]. Return -1 at the end, or the position of an instruction dividing by 0
+SIMD_CLONES int run_vectorized(program* p, uint32_t* lanes, int count) {
+    int vectors = (count + LANES - 1) / LANES;      //Lanes past 'count' hold garbage, which is computed and ignored
+
+    #define LANE_LOOP(statement) for (int v=0; v<vectors; v++) { statement; } break
+    #define BINARY_LANES(name, type, operator) \
+        case name: LANE_LOOP(((type*) a)[v] = ((type*) b)[v] operator ((type*) c)[v])
+    #define COMPARE_LANES(name, type, operator) \
+        case name: LANE_LOOP(((int_lanes*) a)[v] = (int_lanes) (((type*) b)[v] operator ((type*) c)[v]) & 1)
+    #define COMPARE_ALL(suffix, type)                  \
+        COMPARE_LANES(OP_EQ_##suffix, type, ==);       \
+        COMPARE_LANES(OP_GE_##suffix, type, >=);       \
+        COMPARE_LANES(OP_LE_##suffix, type, <=);       \
+        COMPARE_LANES(OP_GT_##suffix, type, >);        \
+        COMPARE_LANES(OP_LT_##suffix, type, <)
+
+    for (int i = 0; i < p->length; i++) {
+        instr* in = &p->code[i];
+        uint32_t* a = lanes + (size_t) in->a * COLUMN_BATCH;
+        uint32_t* b = lanes + (size_t) in->b * COLUMN_BATCH;
+        uint32_t* c = lanes + (size_t) in->c * COLUMN_BATCH;
+
+        switch (in->op) {
+            case OP_MOV: LANE_LOOP(((int_lanes*) a)[v] = ((int_lanes*) b)[v]);
+            case OP_I2F: LANE_LOOP(((real_lanes*) a)[v] = TO_REAL(((signed_lanes*) b)[v]));
+
+            BINARY_LANES(OP_ADD_I, int_lanes, +);       //Unsigned, so that overflows wrap around
+            BINARY_LANES(OP_SUB_I, int_lanes, -);
+            BINARY_LANES(OP_MUL_I, int_lanes, *);
+            case OP_DIV_I:                              //No vector instruction divides integers
+            case OP_MOD_I:
+                for (int k = 0; k < count; k++) {
+                    int32_t x = b[k], y = c[k];
+                    if (y == 0)
+                        return i;
+                    if (y == -1)                        //INT_MIN / -1 would trap: wrap around as the virtual machine does
+                        a[k] = (in->op == OP_DIV_I) ? 0u - (uint32_t) x : 0;
+                    else
+                        a[k] = (in->op == OP_DIV_I) ? x / y : x % y;
+                }
+                break;
+
+            BINARY_LANES(OP_ADD_F, real_lanes, +);
+            BINARY_LANES(OP_SUB_F, real_lanes, -);
+            BINARY_LANES(OP_MUL_F, real_lanes, *);
+            case OP_DIV_F:
+                for (int k = 0; k < count; k++)
+                    if (((float*) c)[k] == 0)
+                        return i;
+                LANE_LOOP(((real_lanes*) a)[v] = ((real_lanes*) b)[v] / ((real_lanes*) c)[v]);
+
+            BINARY_LANES(OP_AND, int_lanes, &);         //Booleans are 0 or 1
+            BINARY_LANES(OP_OR, int_lanes, |);
+            case OP_NOT: LANE_LOOP(((int_lanes*) a)[v] = ((int_lanes*) b)[v] ^ 1);
+
+            COMPARE_ALL(I, signed_lanes);
+            COMPARE_ALL(F, real_lanes);
+            COMPARE_ALL(C, signed_lanes);
+            COMPARE_ALL(B, signed_lanes);
+
+            case OP_RET:
+                return -1;
+            default:                //Excluded by can_vectorize
+                break;
+        }
+    }
+    return -1;
+
+    #undef LANE_LOOP
+    #undef BINARY_LANES
+    #undef COMPARE_LANES
+    #undef COMPARE_ALL
+}
+
+//Registers whose value is read before being written, other than constants: they have to be 0 at the start of each batch
+bool* find_unset_registers(program* p) {
+    bool* written = calloc(p->register_count, sizeof(bool));
+    bool* unset = calloc(p->register_count, sizeof(bool));
+
+    for (int i = 0; i < p->length; i++) {
+        instr* in = &p->code[i];
+        const char* format = opcode_formats[in->op];
+        if (format[1] == 'r' && !written[in->b])
+            unset[in->b] = true;
+        if (format[2] == 'r' && !written[in->c])
+            unset[in->c] = true;
+        if (format[0] == 'r')
+            written[in->a] = true;
+    }
+    if (!written[p->result])
+        unset[p->result] = true;
+    for (int r = p->constant_base; r < p->register_count; r++)
+        unset[r] = false;
+
+    free(written);
+    return unset;
+}
+
+//Evaluate the program over every row of the input, writing one result per line to 'output' (standard output if NULL),
+// then print the throughput. Return the number of rows evaluated
+long evaluate_columns(program* p, int mode, char* output) {
+    column_input* in = context->columns;
+    if (p->result_type == UNKNOWN_TYPE)
+        fatal_error("The program must return a value to be evaluated over columns");
+
+    bool vectorized = (mode != COLUMN_MODE_ROW) && can_vectorize(p);
+    if (mode == COLUMN_MODE_VECTOR && !vectorized)
+        fatal_error("The program cannot be vectorized: it contains branches or strings");
+
+    FILE* out = (output != NULL) ? fopen(output, "w") : stdout;
+    if (out == NULL) {
+        printf("Cannot write %s!\n", output);
+        exit(1);
+    }
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    uint32_t* buffer = malloc(in->count * COLUMN_BATCH * sizeof(uint32_t));
+    values* regs = calloc(p->register_count, sizeof(values));
+    if (p->constant_count > 0)
+        memcpy(regs + p->constant_base, p->constants, p->constant_count * sizeof(values));
+
+    uint32_t* lanes = NULL;
+    bool* unset = NULL;
+    if (vectorized) {
+        lanes = aligned_alloc(32, (size_t) p->register_count * COLUMN_BATCH * sizeof(uint32_t));
+        for (int k = 0; k < p->constant_count; k++) {       //Each lane of a constant register holds the constant
+            uint32_t lane = lane_of_value(p->constant_types[k], p->constants[k]);
+            uint32_t* target = lanes + (size_t) (p->constant_base + k) * COLUMN_BATCH;
+            for (int row = 0; row < COLUMN_BATCH; row++)
+                target[row] = lane;
+        }
+        unset = find_unset_registers(p);
+    }
+
+    int count;
+    while ((count = read_rows(in, buffer)) > 0) {
+        if (!vectorized) {
+            evaluate_rows(p, regs, buffer, count, out);
+            continue;
+        }
+
+        for (int r = 0; r < p->constant_base; r++)
+            if (unset[r])
+                memset(lanes + (size_t) r * COLUMN_BATCH, 0, COLUMN_BATCH * sizeof(uint32_t));
+        for (int column = 0; column < in->count; column++)
+            if (in->slots[column] >= 0)
+                memcpy(lanes + (size_t) in->slots[column] * COLUMN_BATCH, buffer + column * COLUMN_BATCH, count * sizeof(uint32_t));
+
+        //A division by 0 was found: the batch is evaluated again one row at a time, which stops at the first failing row
+        // after writing the results of the rows before it, exactly like the evaluation without vectors
+        if (run_vectorized(p, lanes, count) >= 0) {
+            evaluate_rows(p, regs, buffer, count, out);
+            continue;
+        }
+
+        uint32_t* result = lanes + (size_t) p->result * COLUMN_BATCH;
+        for (int k = 0; k < count; k++) {
+            values value = value_of_lane(p->result_type, result[k]);
+            write_result(out, p->result_type, &value);
+        }
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    if (out != stdout)
+        fclose(out);
+    free(buffer);
+    free(regs);
+    free(lanes);
+    free(unset);
+
+    long rows = in->next_row;
+    context->stats.column_rows = rows;
+    double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    printf("\nEvaluated %ld rows in %.3f s: %.0f rows/s (%s)\n",
+           rows, seconds, (seconds > 0) ? rows / seconds : 0, vectorized ? "vectorized" : "one row at a time");
+    return rows;
+}
+
+
+//Release the input of column mode
+void close_columns_input(column_input* in) {
+    if (in->file != NULL)
+        fclose(in->file);
+    if (in->mapped != NULL)
+        munmap(in->mapped, in->mapped_length);
+    for (int column = 0; column < in->count; column++)
+        free(in->names[column]);
+    free(in->names);
+    free(in->slots);
+    free(in->types);
+    free(in->line);
+    free(in);
+}
+
+void close_columns() {
+    if (context->columns != NULL)
+        close_columns_input(context->columns);
+    context->columns = NULL;
+}
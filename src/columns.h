@@ -0,0 +1,55 @@
+#ifndef COLUMNS_H
+#define COLUMNS_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Column mode, selected with --columns: the program is a formula, evaluated once for every row of an input table.
+   Global variables named like the columns of the input are bound to them: their initializer is ignored, and every row
+   gives them a new value. Rows are read in batches of COLUMN_BATCH. When the program has no jumps and no strings, each
+   instruction is applied to the whole batch before moving to the next one (see run_vectorized), by loops over vector
+   types that the compiler turns into SSE or AVX2 instructions, chosen at run time. Other programs are executed by the
+   virtual machine once per row. Building with -DNO_SIMD replaces the vector types with plain scalars */
+
+#define COLUMN_BATCH 1024       //Rows evaluated together, a multiple of the lanes of a vector
+
+// Formats of the input
+#define COLUMNS_CSV 0           //A header line with the names of the columns, then one line of comma-separated values per row
+#define COLUMNS_BINARY 1        //The same header line, followed by each column as an array of 4-byte values (see open_columns)
+
+// Evaluation modes, selected with --column-mode
+#define COLUMN_MODE_AUTO 0      //Vectorized if the program allows it, otherwise one row at a time
+#define COLUMN_MODE_VECTOR 1
+#define COLUMN_MODE_ROW 2
+
+//Struct describing the input of column mode (see 'columns' in compilation.h)
+typedef struct column_input {
+    char* path;
+    int format;                 //From the above define list
+    FILE* file;                 //CSV input
+    char* line;                 //Last line read from a CSV file
+    size_t line_capacity;
+    char* mapped;               //Binary input, mapped in memory
+    size_t mapped_length;
+    size_t data_offset;         //Position of the first column in a binary file
+    long row_count;             //Rows of a binary file
+    long next_row;              //Number of rows read so far
+
+    char** names;               //Names of the columns, from the header line
+    int count;
+    int* slots;                 //Register of the variable bound to each column, -1 if no global variable has its name
+    int* types;                 //Data type of the bound variable
+} column_input;
+
+
+//Function signatures, see columns.c for implementation
+
+bool open_columns(char* path, int format);
+bool bind_column(int symbol);
+int read_rows(column_input* in, uint32_t* buffer);
+long evaluate_columns(struct program* p, int mode, char* output);
+void close_columns_input(column_input* in);
+void close_columns();
+
+#endif
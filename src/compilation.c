@@ -0,0 +1,65 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "compilation.h"
+
+/* Creation and release of the context of a compilation. Check structs declaration in compilation.h */
+
+_Thread_local compilation* context = NULL;     //Compilation running on this thread
+
+
+//Create the context of a new compilation, with its scanner and its global table, and make it the current one of the thread
+compilation* create_compilation() {
+    compilation* c = calloc(1, sizeof(compilation));
+    if (c == NULL || yylex_init(&c->scanner) != 0) {
+        fprintf(stderr, "Out of memory\n");
+        exit(1);
+    }
+
+    set_initial_state(c);
+    context = c;
+    start_stats();
+    init_global_table();
+    return c;
+}
+
+//Give their first value to the fields that do not start from zero
+void set_initial_state(compilation* c) {
+    c->number_line = 1;
+    c->input_mode = INPUT_STDIO;
+    c->temp_count = 1;
+    c->diagnostics_output = stderr;
+}
+
+//Prepare a compilation whose input has been closed for the next one on the same thread. Everything starts over, except
+// the storage grown by the previous compilations: the scanner, the tables and the intern pool (see reset_compilation_memory)
+void reset_compilation(compilation* c) {
+    context = c;
+    reset_compilation_memory();
+
+    compilation kept = *c;
+    memset(c, 0, sizeof(compilation));
+    c->scanner = kept.scanner;
+    c->global_table = kept.global_table;
+    c->current_table = kept.global_table;
+    c->scopes = kept.scopes;
+    c->scope_capacity = kept.scope_capacity;
+    c->symbols = kept.symbols;
+    c->memory = kept.memory;
+    c->intern_pool = kept.intern_pool;
+    c->intern_capacity = kept.intern_capacity;
+    c->string_pool = kept.string_pool;
+    c->string_capacity = kept.string_capacity;
+
+    set_initial_state(c);
+    start_stats();
+}
+
+//Release everything still held by a compilation. The input must have been closed with close_input
+void free_compilation(compilation* c) {
+    context = c;
+    free_compilation_memory();
+    yylex_destroy(c->scanner);
+    free(c);
+    context = NULL;
+}
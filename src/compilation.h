@@ -0,0 +1,97 @@
+#ifndef COMPILATION_H
+#define COMPILATION_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <setjmp.h>
+#include <time.h>
+#include "arena.h"
+#include "stats.h"
+#include "sym_table.h"
+
+/* State of one compilation: scanner, parser, symbol tables, translation and statistics.
+   Nothing of a compilation lives in global variables, so several compilations can run in the same process,
+   one after the other or on different threads (see batch.c). Each thread works on the compilation pointed
+   by 'context', set by create_compilation; options given on the command line are shared and never modified */
+
+#ifndef YY_TYPEDEF_YY_SCANNER_T
+#define YY_TYPEDEF_YY_SCANNER_T
+typedef void* yyscan_t;         //Reentrant scanner generated by flex, same definition as in lex.yy.c
+#endif
+
+//Struct holding the whole state of a compilation
+typedef struct compilation {
+    //Scanner and parser (see flex.lex and yacc.y)
+    yyscan_t scanner;
+    int number_line;                //Line counter
+    struct node* program_body;      //Statements of the parsed program, set by the 'start' rule
+    struct node* program_result;    //Expression of the return statement, NULL if nothing is returned
+
+    //Input of the scanner (see open_input in flex.lex)
+    int input_mode;                 //Mode actually used: INPUT_AUTO is resolved when the input is opened
+    FILE* input_file;               //File opened by open_input: flex forgets it when it scans a buffer in memory
+    bool interactive_input;         //Standard input is a terminal: read one line at a time
+    long input_bytes;               //Bytes given to the scanner so far
+    char* mapped_input;             //Memory mapping of the file, in mmap mode
+    void* input_buffer;             //Buffer of the scanner over the mapping or the stream, deleted by close_input
+    size_t mapped_length;
+    struct token_buffer* tokens;    //Tokens scanned ahead by several threads, pulled instead of scanning (see token_buffer.h)
+    struct token_chunk* lexing_chunk;   //Chunk scanned by this compilation, on a thread of the parallel lexing
+
+    //Symbol tables (see sym_table.c)
+    struct sym_table* global_table;
+    struct sym_table* current_table;    //Table in which the program is currently. It is initially equal to global_table
+    struct sym_table** scopes;      //Stack of the tables, indexed by block depth (global_table first). Tables above the
+    int scope_capacity;             //  current depth belong to blocks already closed, and are reused by the next ones
+    symbol_store symbols;           //Symbols of all the open blocks
+    int temp_count;
+    int slot_count;                 //Number of registers assigned to variables so far, each reused across sibling blocks (see take_slot)
+    struct temp_elem* free_temps;   //Pool of temporaries ready to be reused, linked through element.next
+    arena memory;                   //Memory for data needed until the end of the compilation (identifiers, strings, nodes)
+    int block_depth;                //Number of blocks currently open inside the global one
+    struct ident** intern_pool;     //Open-addressing hash table holding every identifier seen so far
+    int intern_capacity;
+    int intern_count;
+    char** string_pool;             //Open-addressing hash table holding every string value, see intern_string
+    int string_capacity;
+    int string_count;
+
+    //Translation to bytecode and optimization (see bytecode.c and optimize.c)
+    int next_temp;                  //First free temporary register
+    int max_temp;                   //Highest temporary register used so far, plus one
+    int folded_nodes;               //Statistics of the optimization, printed with --opt-report
+    int removed_branches;
+
+    //Statistics (see stats.c)
+    compile_stats stats;
+    int current_phase;
+    struct timespec phase_start;    //When the current phase was entered
+
+    //Incremental compilation (see cache.c)
+    struct region_cache* cache;     //Cache of the regions of the source, with --cache-dir
+    bool region_pending;            //A single region is being parsed: the scanner has to start with the REGION token
+    void* region_buffer;            //Buffer of the scanner holding the text of the region
+    struct node* region_tree;       //Tree of the region, set by the 'start' rule
+
+    //Column mode (see columns.c)
+    struct column_input* columns;   //Input whose columns are bound to the global variables, with --columns
+
+    //Errors (see diagnostics.c)
+    struct diagnostic* diagnostics;         //Errors found so far, in order
+    struct diagnostic* last_diagnostic;
+    int error_count;
+    FILE* diagnostics_output;       //Where errors are printed as they are found, NULL to just collect them
+    jmp_buf* on_error;              //If set, a compilation stopped by errors jumps here instead of terminating the process
+} compilation;
+
+extern _Thread_local compilation* context;
+
+
+//Function signatures, see compilation.c for implementation
+
+compilation* create_compilation();
+void set_initial_state(compilation* c);
+void reset_compilation(compilation* c);
+void free_compilation(compilation* c);
+
+#endif
@@ -0,0 +1,73 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include "diagnostics.h"
+#include "compilation.h"
+
+/* Collection and report of the errors. Check structs declaration in diagnostics.h */
+
+int max_errors = DEFAULT_MAX_ERRORS;    //Set by --max-errors, 0 for no limit
+
+
+//Add an error to the compilation, on the current line. It is printed at once, unless the compilation runs in a batch
+void add_diagnostic(bool fatal, const char* format, va_list arguments) {
+    char text[512];
+    vsnprintf(text, sizeof(text), format, arguments);
+    text[strcspn(text, "\n")] = '\0';       //Some messages end with a newline
+
+    diagnostic* d = arena_alloc(&context->memory, sizeof(diagnostic));
+    d->line = context->number_line;
+    d->fatal = fatal;
+    d->message = arena_strndup(&context->memory, text, strlen(text));
+    d->next = NULL;
+
+    if (context->last_diagnostic == NULL)
+        context->diagnostics = d;
+    else
+        context->last_diagnostic->next = d;
+    context->last_diagnostic = d;
+    context->error_count++;
+
+    if (context->diagnostics_output != NULL)
+        print_diagnostic(context->diagnostics_output, d);
+}
+
+void print_diagnostic(FILE* out, diagnostic* d) {
+    fprintf(out, "\n%s on line %d: %s\n", d->fatal ? "Fatal error" : "Error", d->line, d->message);
+}
+
+//Report a recoverable error: the compilation goes on, but the program will not be executed.
+// Also called by the parser for syntax errors. Note that the function is an extension over printf
+void yyerror(const char* str, ...) {
+    va_list varlist;
+    va_start (varlist, str);
+    add_diagnostic(false, str, varlist);
+    va_end (varlist);
+
+    if (max_errors > 0 && context->error_count >= max_errors)
+        fatal_error("Too many errors, compilation stopped");
+}
+
+//Report an error after which the compilation cannot go on (errors at run time, failures of the input), and stop it
+void fatal_error(const char* str, ...) {
+    va_list varlist;
+    va_start (varlist, str);
+    add_diagnostic(true, str, varlist);
+    va_end (varlist);
+
+    stop_compilation();
+}
+
+//Stop a compilation with errors. In a batch, go back to the driver (see batch.c), otherwise terminate the program
+void stop_compilation() {
+    if (context->on_error != NULL)
+        longjmp(*context->on_error, 1);
+
+    if (context->error_count > 1)
+        fprintf(stderr, "\n%d errors\n", context->error_count);
+    print_table();
+    close_trace();
+
+    exit(1);
+}
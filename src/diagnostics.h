@@ -0,0 +1,35 @@
+#ifndef DIAGNOSTICS_H
+#define DIAGNOSTICS_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdarg.h>
+
+/* Errors found while compiling. Most of them are recoverable: they are collected in the compilation (see compilation.h)
+   and the compilation goes on, so that a single run reports all of them. The parser resynchronizes at the next ';',
+   and an expression containing errors gets ERROR_TYPE, which the type checker accepts silently to avoid cascades.
+   The program is executed only if no error was found. Fatal errors, and reaching the limit set by --max-errors,
+   stop the compilation at once */
+
+#define DEFAULT_MAX_ERRORS 20
+
+//Struct defining one error, kept in the memory of the compilation
+typedef struct diagnostic {
+    int line;
+    bool fatal;
+    char* message;
+    struct diagnostic* next;
+} diagnostic;
+
+extern int max_errors;
+
+
+//Function signatures, see diagnostics.c for implementation
+
+void add_diagnostic(bool fatal, const char* format, va_list arguments);
+void print_diagnostic(FILE* out, diagnostic* d);
+void yyerror(const char* str, ...);
+__attribute__((noreturn)) void fatal_error(const char* str, ...);     //Never returns: it exits or jumps back to the driver
+__attribute__((noreturn)) void stop_compilation();
+
+#endif
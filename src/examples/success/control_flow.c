@@ -0,0 +1,30 @@
+int i = 0, evens = 0, odds = 0, sum = 0;
+char grade = 'b';
+int points = 0;
+
+while (i < 10) {
+    if (i % 2 == 0) {
+        evens = evens + 1;
+    } else {
+        odds = odds + 1;
+    }
+    i = i + 1;
+}
+
+for (int j = 1; j <= 100; j = j + 1) {
+    sum = sum + j;
+}
+
+switch (grade) {
+    case 'a': points = 10; break;
+    case 'b': points = 8; break;
+    default: points = 0;
+}
+
+if (false) {
+    sum = 0;
+} else if (evens == odds) {
+    sum = sum + points;
+}
+
+return sum;     //5058
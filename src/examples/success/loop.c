@@ -0,0 +1,11 @@
+//Counting loop with 10^8 iterations, useful to measure the speed of the virtual machine
+
+int i = 0, n = 100000000;
+int count = 0;
+
+while (i < n) {
+    count = count + 1;
+    i = i + 1;
+}
+
+return count;
@@ -0,0 +1,8 @@
+int a = 3, b = 4, x = 0, y = 0, z = 0, w = 7;
+x = a * b + (a * b) * 2;
+y = (a * b) - 1 + 0;
+z = x * 1 + y;
+if (false) { z = 0; }
+while (1 > 2) { z = z + 1; }
+switch (w) { case 1: z = 1; break; case 3: z = z + 3; break; default: z = 9; }
+return z + (8*7);     //65
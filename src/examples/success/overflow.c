@@ -0,0 +1,9 @@
+//INT_MIN / -1 overflows: the quotient wraps around to INT_MIN, and the remainder is 0
+int min = -2147483647 - 1, divisor = 0, quotient = 0, remainder = 1;
+
+while (divisor > -1) {
+    divisor = divisor - 1;
+    quotient = min / divisor;
+    remainder = min % divisor;
+}
+return quotient + remainder;     //-2147483648
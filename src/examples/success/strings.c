@@ -0,0 +1,10 @@
+char* s;
+bool c = false;
+bool r;
+
+if (c) {
+    s = "x";
+}
+r = s < "y";
+
+return r;
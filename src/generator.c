@@ -0,0 +1,374 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include "generator.h"
+#include "sym_table.h"
+
+/* Generation of random programs. Check structs declaration in generator.h */
+
+
+//Knobs accepted by parse_generator_options, with their position in the options
+static const struct {
+    const char* key;
+    size_t offset;
+} generator_keys[] = {
+    { "statements", offsetof(generator_options, statements) },
+    { "declarations", offsetof(generator_options, declarations) },
+    { "depth", offsetof(generator_options, expression_depth) },
+    { "nesting", offsetof(generator_options, nesting_depth) },
+    { "literals", offsetof(generator_options, literal_percent) },
+    { "assign", offsetof(generator_options, assign_weight) },
+    { "if", offsetof(generator_options, if_weight) },
+    { "while", offsetof(generator_options, while_weight) },
+    { "for", offsetof(generator_options, for_weight) },
+    { "switch", offsetof(generator_options, switch_weight) },
+    { "seed", offsetof(generator_options, seed) },
+};
+
+void default_generator_options(generator_options* options) {
+    options->statements = 1000;
+    options->declarations = 100;
+    options->expression_depth = 3;
+    options->nesting_depth = 3;
+    options->literal_percent = 30;
+    options->assign_weight = 6;
+    options->if_weight = 2;
+    options->while_weight = 1;
+    options->for_weight = 1;
+    options->switch_weight = 1;
+    options->seed = 1;
+}
+
+//Read a specification such as "statements=5000,nesting=6,switch=0" into the options, over the defaults.
+// Return false if a key is unknown or a value is not a number
+bool parse_generator_options(char* spec, generator_options* options) {
+    default_generator_options(options);
+    char* copy = strdup(spec);
+    char* position = NULL;
+    bool valid = true;
+
+    for (char* pair = strtok_r(copy, ",", &position); pair != NULL && valid; pair = strtok_r(NULL, ",", &position)) {
+        char* equal = strchr(pair, '=');
+        char* end = NULL;
+        long value = (equal != NULL) ? strtol(equal + 1, &end, 10) : -1;
+        valid = equal != NULL && end != equal + 1 && *end == '\0' && value >= 0;
+        if (!valid)
+            break;
+
+        *equal = '\0';
+        int key = 0;
+        int key_count = sizeof(generator_keys) / sizeof(generator_keys[0]);
+        while (key < key_count && strcmp(generator_keys[key].key, pair) != 0)
+            key++;
+        if (key == key_count)
+            valid = false;
+        else
+            *(int*) ((char*) options + generator_keys[key].offset) = (int) value;
+    }
+    free(copy);
+
+    if (options->declarations < 1)          //Assignments need at least one variable
+        options->declarations = 1;
+    if (options->nesting_depth > GENERATOR_MAX_NESTING)
+        options->nesting_depth = GENERATOR_MAX_NESTING;
+    return valid;
+}
+
+
+// Random choices
+//-------------------------------------------------------------------------------------
+
+//Next number of the xorshift64* sequence
+uint64_t next_random(generator* g) {
+    g->random ^= g->random >> 12;
+    g->random ^= g->random << 25;
+    g->random ^= g->random >> 27;
+    return g->random * 2685821657736338717ull;
+}
+
+int random_below(generator* g, int limit) {
+    return (int) ((next_random(g) >> 32) % (uint64_t) limit);
+}
+
+bool chance(generator* g, int percent) {
+    return random_below(g, 100) < percent;
+}
+
+
+// Expressions
+//-------------------------------------------------------------------------------------
+
+//Letter starting the names of the variables of a type
+char type_letter(int type) {
+    return (type == INT_TYPE) ? 'i' : (type == REAL_TYPE) ? 'f' : 'b';
+}
+
+void generate_literal(generator* g, int type) {
+    if (type == INT_TYPE)
+        fprintf(g->out, "%d", random_below(g, 100));
+    else if (type == REAL_TYPE)
+        fprintf(g->out, "%d.%d", random_below(g, 10), random_below(g, 100));
+    else
+        fputs(chance(g, 50) ? "true" : "false", g->out);
+}
+
+//Write a variable of the given type chosen among the visible ones, or a literal if there are none
+void generate_leaf(generator* g, int type) {
+    if (!chance(g, g->options.literal_percent)) {
+        int start = random_below(g, g->visible_count);
+        for (int i = 0; i < g->visible_count; i++) {
+            generated_variable* v = &g->visible[(start + i) % g->visible_count];
+            if (v->type == type) {
+                fprintf(g->out, "%c%d", type_letter(type), v->number);
+                return;
+            }
+        }
+    }
+    generate_literal(g, type);
+}
+
+//Write an expression of the given type, with at most 'depth' nested operators. Every operation is parenthesized,
+// and divisions are only by positive literals, so that the program cannot divide by 0
+void generate_expression(generator* g, int type, int depth) {
+    if (depth == 0 || chance(g, 25)) {
+        generate_leaf(g, type);
+        return;
+    }
+
+    static const char* arithmetic[] = { "+", "-", "*", "/", "%" };
+    static const char* comparisons[] = { "==", ">=", "<=", ">", "<" };
+    fputc('(', g->out);
+    if (type == INT_TYPE) {
+        int op = random_below(g, 5);
+        generate_expression(g, INT_TYPE, depth - 1);
+        fprintf(g->out, " %s ", arithmetic[op]);
+        if (op >= 3)
+            fprintf(g->out, "%d", 1 + random_below(g, 9));
+        else
+            generate_expression(g, INT_TYPE, depth - 1);
+    } else if (type == REAL_TYPE) {
+        int op = random_below(g, 4);         //No modulo between reals
+        generate_expression(g, REAL_TYPE, depth - 1);
+        fprintf(g->out, " %s ", arithmetic[op]);
+        if (op == 3)
+            fprintf(g->out, "%d.5", random_below(g, 9));
+        else
+            generate_expression(g, chance(g, 25) ? INT_TYPE : REAL_TYPE, depth - 1);     //INT operands are converted
+    } else {
+        switch (random_below(g, 4)) {
+            case 0:
+            case 1: {
+                int operand_type = chance(g, 70) ? INT_TYPE : REAL_TYPE;
+                generate_expression(g, operand_type, depth - 1);
+                fprintf(g->out, " %s ", comparisons[random_below(g, 5)]);
+                generate_expression(g, operand_type, depth - 1);
+                break;
+            }
+            case 2:
+                generate_expression(g, BOOL_TYPE, depth - 1);
+                fputs(chance(g, 50) ? " && " : " || ", g->out);
+                generate_expression(g, BOOL_TYPE, depth - 1);
+                break;
+            default:
+                fputc('!', g->out);
+                generate_expression(g, BOOL_TYPE, depth - 1);
+                break;
+        }
+    }
+    fputc(')', g->out);
+}
+
+
+// Statements
+//-------------------------------------------------------------------------------------
+
+void generate_indent(generator* g) {
+    fprintf(g->out, "%*s", 4 * g->indent, "");
+}
+
+//Declare a new variable of the given type in the current block, initialized with a literal
+void declare_variable(generator* g, int type) {
+    if (g->visible_count == g->visible_capacity) {
+        g->visible_capacity = (g->visible_capacity == 0) ? 64 : g->visible_capacity * 2;
+        g->visible = realloc(g->visible, g->visible_capacity * sizeof(generated_variable));
+    }
+    generated_variable* v = &g->visible[g->visible_count++];
+    v->number = g->next_number++;
+    v->type = type;
+
+    generate_indent(g);
+    fprintf(g->out, "%s %c%d = ", (type == INT_TYPE) ? "int" : (type == REAL_TYPE) ? "float" : "bool", type_letter(type), v->number);
+    generate_literal(g, type);
+    fputs(";\n", g->out);
+}
+
+void generate_statements(generator* g, int count, int compounds);
+
+//Write a block with a few declarations and statements, of which at most 'compounds' open blocks in turn, so that the
+// size of the program grows linearly with the nesting depth. 'last' is written as its final statement, if not NULL
+void generate_block(generator* g, int compounds, const char* last, int counter) {
+    int visible = g->visible_count;
+    fputs("{\n", g->out);
+    g->depth++;
+    g->indent++;
+
+    for (int i = random_below(g, 3); i > 0; i--)
+        declare_variable(g, random_below(g, 2) ? INT_TYPE : REAL_TYPE);
+    generate_statements(g, 1 + random_below(g, 3), compounds);
+    if (last != NULL) {
+        generate_indent(g);
+        fprintf(g->out, last, counter, counter);
+    }
+
+    g->indent--;
+    g->depth--;
+    g->visible_count = visible;     //Variables of the block are no longer visible
+    generate_indent(g);
+    fputc('}', g->out);
+}
+
+void generate_assignment(generator* g) {
+    generated_variable* v = &g->visible[random_below(g, g->visible_count)];
+    generate_indent(g);
+    fprintf(g->out, "%c%d = ", type_letter(v->type), v->number);
+    generate_expression(g, v->type, g->options.expression_depth);
+    fputs(";\n", g->out);
+}
+
+void generate_if(generator* g) {
+    generate_indent(g);
+    fputs("if (", g->out);
+    generate_expression(g, BOOL_TYPE, g->options.expression_depth);
+    fputs(") ", g->out);
+    generate_block(g, 1, NULL, 0);
+
+    for (int i = random_below(g, 3); i > 0; i--) {
+        fputs(" else if (", g->out);
+        generate_expression(g, BOOL_TYPE, g->options.expression_depth);
+        fputs(") ", g->out);
+        generate_block(g, 0, NULL, 0);
+    }
+    if (chance(g, 50)) {
+        fputs(" else ", g->out);
+        generate_block(g, 0, NULL, 0);
+    }
+    fputc('\n', g->out);
+}
+
+//Loops count with the counter of their depth, declared at the top of the program and hidden from the other statements
+void generate_while(generator* g) {
+    int counter = g->depth;
+    generate_indent(g);
+    fprintf(g->out, "w%d = 0;\n", counter);
+    generate_indent(g);
+    fprintf(g->out, "while (w%d < %d) ", counter, GENERATOR_LOOP_COUNT);
+    g->loops++;
+    generate_block(g, 1, "w%d = w%d + 1;\n", counter);
+    g->loops--;
+    fputc('\n', g->out);
+}
+
+//The counter of a for is declared in the enclosing block, so it gets a name never used before
+void generate_for(generator* g) {
+    int counter = g->next_number++;
+    generate_indent(g);
+    fprintf(g->out, "for (int c%d = 0; c%d < %d; c%d = c%d + 1) ", counter, counter, GENERATOR_LOOP_COUNT, counter, counter);
+    g->loops++;
+    generate_block(g, 1, NULL, 0);
+    g->loops--;
+    fputc('\n', g->out);
+}
+
+//Switch on an int variable, with distinct cases. Returns false if no int variable is visible
+bool generate_switch(generator* g) {
+    generated_variable* scrutinee = NULL;
+    int start = random_below(g, g->visible_count);
+    for (int i = 0; i < g->visible_count && scrutinee == NULL; i++)
+        if (g->visible[(start + i) % g->visible_count].type == INT_TYPE)
+            scrutinee = &g->visible[(start + i) % g->visible_count];
+    if (scrutinee == NULL)
+        return false;
+
+    generate_indent(g);
+    fprintf(g->out, "switch (i%d) {\n", scrutinee->number);
+    g->depth++;                     //Cases count as a nesting level, though they open no block
+    g->indent++;
+    int value = random_below(g, 5);
+    int compounds = 1;              //Only one case may nest further, as only one branch of an if does
+    for (int i = 1 + random_below(g, 3); i > 0; i--, compounds = 0) {
+        generate_indent(g);
+        fprintf(g->out, "case %d:\n", value);
+        value += 1 + random_below(g, 5);
+        g->indent++;
+        generate_statements(g, 1 + random_below(g, 2), compounds);
+        generate_indent(g);
+        fputs("break;\n", g->out);
+        g->indent--;
+    }
+    if (chance(g, 50)) {
+        generate_indent(g);
+        fputs("default:\n", g->out);
+        g->indent++;
+        generate_statements(g, 1, 0);
+        g->indent--;
+    }
+    g->indent--;
+    g->depth--;
+    generate_indent(g);
+    fputs("}\n", g->out);
+    return true;
+}
+
+//Write 'count' statements, choosing their kind with the weights of the options, with at most 'compounds' of them
+// opening blocks. At the maximum nesting depth only assignments are written, and loops are not nested beyond
+// GENERATOR_MAX_LOOPS, so that the execution time stays proportional to the size of the program
+void generate_statements(generator* g, int count, int compounds) {
+    generator_options* o = &g->options;
+    bool nested = g->depth < o->nesting_depth;
+    int loop_weight = (g->loops < GENERATOR_MAX_LOOPS) ? o->while_weight + o->for_weight : 0;
+    int total = o->assign_weight + (nested ? o->if_weight + loop_weight + o->switch_weight : 0);
+
+    for (int i = 0; i < count; i++) {
+        int pick = (total > 0) ? random_below(g, total) : 0;
+        if (!nested || compounds == 0 || (pick -= o->assign_weight) < 0) {
+            generate_assignment(g);
+            continue;
+        }
+        compounds--;
+        if ((pick -= o->if_weight) < 0)
+            generate_if(g);
+        else if (loop_weight > 0 && (pick -= o->while_weight) < 0)
+            generate_while(g);
+        else if (loop_weight > 0 && (pick -= o->for_weight) < 0)
+            generate_for(g);
+        else if (!generate_switch(g))
+            generate_assignment(g);
+    }
+}
+
+//Write a whole program: the declarations, the counters of the loops, the statements and the return
+void generate_program(generator_options* options, FILE* out) {
+    generator g;
+    memset(&g, 0, sizeof(g));
+    g.options = *options;
+    g.out = out;
+    g.random = 0x9E3779B97F4A7C15ull ^ (uint64_t) options->seed;
+    g.next_number = 1;
+
+    fprintf(out, "// Generated: statements=%d,declarations=%d,depth=%d,nesting=%d,literals=%d,assign=%d,if=%d,while=%d,for=%d,switch=%d,seed=%d\n",
+            options->statements, options->declarations, options->expression_depth, options->nesting_depth, options->literal_percent,
+            options->assign_weight, options->if_weight, options->while_weight, options->for_weight, options->switch_weight, options->seed);
+    static const int types[] = { INT_TYPE, REAL_TYPE, BOOL_TYPE };
+    for (int i = 0; i < options->declarations; i++)
+        declare_variable(&g, types[i % 3]);
+    for (int depth = 0; depth < options->nesting_depth; depth++)
+        fprintf(out, "int w%d = 0;\n", depth);
+
+    generate_statements(&g, options->statements, options->statements);
+
+    fputs("return ", out);
+    generate_expression(&g, INT_TYPE, options->expression_depth);
+    fputs(";\n", out);
+    free(g.visible);
+}
@@ -0,0 +1,59 @@
+#ifndef GENERATOR_H
+#define GENERATOR_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Generator of random valid programs, selected with --generate, and used by --benchmark to build inputs of any size.
+   Programs are built from a seed, so the same options always give the same program. They declare int, float and bool
+   variables, all initialized, and use only expressions that type check: divisions are by positive literals, loops
+   count up to a small limit, so every generated program compiles and terminates */
+
+#define GENERATOR_LOOP_COUNT 3      //Iterations of each generated loop
+#define GENERATOR_MAX_NESTING 64    //Highest nesting depth accepted
+#define GENERATOR_MAX_LOOPS 4       //Loops nested in each other, at most
+
+//Struct holding the knobs of the generator, given as "key=value" pairs (see parse_generator_options)
+typedef struct generator_options {
+    int statements;             //Top-level statements
+    int declarations;           //Top-level variables
+    int expression_depth;       //Operators nested in an expression, at most
+    int nesting_depth;          //Blocks nested in a statement, at most
+    int literal_percent;        //Leaves of the expressions that are literals instead of variables
+    int assign_weight;          //Relative frequency of each kind of statement
+    int if_weight;
+    int while_weight;
+    int for_weight;
+    int switch_weight;
+    int seed;
+} generator_options;
+
+//Struct describing a variable visible at some point of the program being generated
+typedef struct generated_variable {
+    int number;                 //The name is the type letter followed by the number, such as "i12"
+    int type;
+} generated_variable;
+
+//Struct holding the state of a generation
+typedef struct generator {
+    generator_options options;
+    FILE* out;
+    uint64_t random;            //State of the xorshift generator
+    generated_variable* visible;    //Variables of the open blocks, outermost first
+    int visible_count;
+    int visible_capacity;
+    int next_number;            //Numbers given to variables so far, so that every name is unique
+    int depth;                  //Blocks currently open
+    int loops;                  //Loops currently open
+    int indent;
+} generator;
+
+
+//Function signatures, see generator.c for implementation
+
+void default_generator_options(generator_options* options);
+bool parse_generator_options(char* spec, generator_options* options);
+void generate_program(generator_options* options, FILE* out);
+
+#endif
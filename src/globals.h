@@ -1,9 +1,22 @@
-//Functions and variables defined in LEX
-extern FILE *yyin;
-extern int yylex();
-extern int number_line;
-extern void yyerror(char* str, ...);
+//Functions defined in LEX. The scanner is reentrant: its state is passed as the last argument (a yyscan_t, see compilation.h)
+union YYSTYPE;
+struct YYLTYPE;
+extern int yylex(union YYSTYPE* value, struct YYLTYPE* location, void* scanner);
+extern int yylex_init(void** scanner);
+extern int yylex_destroy(void* scanner);
+extern bool open_input(char* path, int mode);
+extern void close_input();
+extern void open_region(const char* text, int length, int line);
+extern void close_region();
+extern void open_text_input(char* text, int length);
+
+// Input modes, selected with --input-mode (see open_input)
+#define INPUT_AUTO 0        //mmap for regular files, streaming for pipes and terminals
+#define INPUT_STDIO 1       //Buffered reads through the FILE* (flex default)
+#define INPUT_MMAP 2        //The whole file mapped in memory, scanned in place
+#define INPUT_STREAM 3      //Large blocks read with read(2)
 
 //Functions and variables defined in LEX
 extern bool verbose;
 extern const char* get_token_name(int token);
+extern bool is_token(int value);
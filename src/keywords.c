@@ -0,0 +1,37 @@
+#include <string.h>
+#include <stdbool.h>
+#include "sym_table.h"
+#include "y.tab.h"
+#include "keywords.h"
+
+/* Table of the keywords, shared by the scanner and by the splitting of the source in regions (see cache.c).
+   Check structs declaration in keywords.h */
+
+#define KEYWORD(text, first, last, token, value) \
+    [KEYWORD_HASH(sizeof(text) - 1, first, last)] = { text, sizeof(text) - 1, token, value },
+
+const keyword keywords[KEYWORD_TABLE_SIZE] = {
+    KEYWORD("int", 'i', 't', INT, INT_TYPE)
+    KEYWORD("float", 'f', 't', FLOAT, REAL_TYPE)
+    KEYWORD("char", 'c', 'r', CHAR, CHAR_TYPE)      //"char*" is matched by a pattern of its own, since it is not an identifier
+    KEYWORD("bool", 'b', 'l', BOOL, BOOL_TYPE)
+    KEYWORD("if", 'i', 'f', IF, IF)
+    KEYWORD("else", 'e', 'e', ELSE, ELSE)
+    KEYWORD("while", 'w', 'e', WHILE, WHILE)
+    KEYWORD("for", 'f', 'r', FOR, FOR)
+    KEYWORD("case", 'c', 'e', CASE, 0)
+    KEYWORD("switch", 's', 'h', SWITCH, 0)
+    KEYWORD("break", 'b', 'k', BREAK, 0)
+    KEYWORD("default", 'd', 't', DEFAULT, 0)
+    KEYWORD("return", 'r', 'n', RETURN, 0)
+    KEYWORD("true", 't', 'e', BOOL_LITERAL, true)
+    KEYWORD("false", 'f', 'e', BOOL_LITERAL, false)
+};
+
+//Return the keyword with the given text, or NULL if it is an identifier
+const keyword* find_keyword(const char* text, int length) {
+    const keyword* k = &keywords[KEYWORD_HASH(length, (unsigned char) text[0], (unsigned char) text[length - 1])];
+    if (k->length == length && memcmp(k->text, text, length) == 0)
+        return k;
+    return NULL;
+}
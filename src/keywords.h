@@ -0,0 +1,26 @@
+#ifndef KEYWORDS_H
+#define KEYWORDS_H
+
+/* Keywords of the language. The scanner matches them with the pattern of the identifiers, and then looks the text up
+   in a table indexed by a perfect hash of its length and of its first and last characters: every keyword has a slot
+   of its own, so a single comparison tells whether an identifier is a keyword. The multipliers of KEYWORD_HASH were
+   chosen for the keywords below; a new keyword that collides with another one shows up as a duplicate designator in
+   the initialization of the table (GCC warns with -Woverride-init), and needs new multipliers */
+
+#define KEYWORD_TABLE_SIZE 32   //Power of two
+#define KEYWORD_HASH(length, first, last) (((length) + 2 * (first) + 6 * (last)) & (KEYWORD_TABLE_SIZE - 1))
+
+//Struct defining a keyword
+typedef struct keyword {
+    const char* text;
+    int length;                 //0 for the empty slots of the table
+    int token;
+    int value;                  //Semantic value of the token: data type of the type names, token of the statements, value of the booleans
+} keyword;
+
+
+//Function signatures, see keywords.c for implementation
+
+const keyword* find_keyword(const char* text, int length);
+
+#endif
@@ -0,0 +1,634 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <spawn.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include "bytecode.h"
+
+extern char** environ;      //Environment passed on to the assembler
+
+/* Native backend: translation of the bytecode into x86-64 assembly (GNU as, AT&T syntax, System V ABI).
+   The output defines 'main', which runs the program and returns the value of its return expression.
+   Every bytecode register is given a location:
+    - the most used INT, CHAR and BOOL registers are kept in the callee-saved registers rbx, r12-r15
+    - the most used REAL registers are kept in xmm8-xmm15, unless the program calls strcmp (which may overwrite them)
+    - the other registers are 8 bytes stack slots below the saved registers
+    - constants are placed in .rodata (INT, CHAR and BOOL ones are also used as immediates)
+   INT, CHAR and BOOL values are handled as 32 bits integers, REAL values with the scalar SSE instructions */
+
+// Internal identifiers needed to classify the content of a register
+#define CLASS_INTEGER 1     //INT, CHAR or BOOL value
+#define CLASS_REAL 2
+#define CLASS_STRING 4
+
+// Kinds of location of a register
+#define LOCATION_STACK 1
+#define LOCATION_GPR 2
+#define LOCATION_XMM 3
+#define LOCATION_CONSTANT 4
+
+#define GPR_COUNT 5
+#define XMM_COUNT 8
+
+const char* gpr_names_32[GPR_COUNT] = { "%ebx", "%r12d", "%r13d", "%r14d", "%r15d" };
+const char* gpr_names_64[GPR_COUNT] = { "%rbx", "%r12", "%r13", "%r14", "%r15" };
+const char* xmm_names[XMM_COUNT] = { "%xmm8", "%xmm9", "%xmm10", "%xmm11", "%xmm12", "%xmm13", "%xmm14", "%xmm15" };
+
+//Struct defining where a register of the bytecode is kept in the generated code
+typedef struct location {
+    int kind;               //Kind of location (from the above define list)
+    int index;              //Stack offset from rbp, index of the machine register, or index of the constant
+} location;
+
+//Struct holding the state of the translation of one program
+typedef struct native_context {
+    program* p;
+    FILE* out;
+    location* locations;
+    int* classes;           //Classes of the values stored in each register, as a bitmask
+    bool* targets;          //Instructions that are the destination of a jump, and need a label
+    int used_gprs;
+    int frame_size;         //Bytes of the stack slots, excluding the saved registers
+} native_context;
+
+
+//Return the class of the values held by registers of the given data type
+int get_type_class(int type) {
+    switch(type) {
+        case REAL_TYPE:   return CLASS_REAL;
+        case STRING_TYPE: return CLASS_STRING;
+        default:          return CLASS_INTEGER;
+    }
+}
+
+//Find which class of values each register holds, from the typed instructions using it.
+// Moves do not have a type, so the classes are propagated through them until nothing changes
+void classify_registers(native_context* ctx) {
+    program* p = ctx->p;
+
+    for (int i=0; i<p->constant_count; i++)
+        ctx->classes[p->constant_base + i] = get_type_class(p->constant_types[i]);
+
+    for (int i=0; i<p->length; i++) {
+        instr* in = &p->code[i];
+        int operands_class = CLASS_INTEGER, result_class = CLASS_INTEGER;
+
+        if (in->op == OP_MOV || in->op == OP_RET || in->op == OP_JMP)
+            continue;
+        if (in->op == OP_I2F)
+            result_class = CLASS_REAL;
+        else if ((in->op >= OP_ADD_F && in->op <= OP_DIV_F))
+            operands_class = result_class = CLASS_REAL;
+        else if (in->op >= OP_EQ_F && in->op <= OP_LT_F)
+            operands_class = CLASS_REAL;
+        else if (in->op >= OP_EQ_S && in->op <= OP_LT_S)
+            operands_class = CLASS_STRING;
+        else if (in->op == OP_SWITCH_S)
+            result_class = CLASS_STRING;        //Not a result: the scrutinee, which is 'a'
+
+        ctx->classes[in->a] |= result_class;
+        if (opcode_formats[in->op][1] == 'r')
+            ctx->classes[in->b] |= operands_class;
+        if (opcode_formats[in->op][2] == 'r')
+            ctx->classes[in->c] |= operands_class;
+    }
+    if (p->result_type != UNKNOWN_TYPE)
+        ctx->classes[p->result] |= get_type_class(p->result_type);
+
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (int i=0; i<p->length; i++) {
+            instr* in = &p->code[i];
+            if (in->op == OP_MOV && ctx->classes[in->a] != ctx->classes[in->b]) {
+                ctx->classes[in->a] = ctx->classes[in->b] = ctx->classes[in->a] | ctx->classes[in->b];
+                changed = true;
+            }
+        }
+    }
+}
+
+//Choose the location of each register. Registers are ranked by their uses, where each use inside a loop
+// counts 8 times as much as one outside of it, and the best ranked ones are assigned to machine registers
+void allocate_registers(native_context* ctx) {
+    program* p = ctx->p;
+    long* weights = malloc(p->length * sizeof(long));
+    long* uses = calloc(p->register_count, sizeof(long));
+    bool calls = false;
+
+    for (int i=0; i<p->length; i++)
+        weights[i] = 1;
+    for (int i=0; i<p->length; i++) {
+        instr* in = &p->code[i];
+        int target = (in->op == OP_JMP) ? in->a : in->b;
+
+        if (in->op == OP_JMP || in->op == OP_JZ || in->op == OP_JNZ) {
+            ctx->targets[target] = true;
+            if (target <= i)            //Backward jump: the instructions in between form a loop
+                for (int j=target; j<=i; j++)
+                    if (weights[j] < 1000000)
+                        weights[j] *= 8;
+        } else if (is_switch(in->op))
+            mark_jump_targets(p, i, ctx->targets);     //Always forward
+        if (in->op >= OP_EQ_S && in->op <= OP_LT_S)
+            calls = true;
+    }
+    for (int i=0; i<p->length; i++) {
+        const char* format = opcode_formats[p->code[i].op];
+        int operands[3] = { p->code[i].a, p->code[i].b, p->code[i].c };
+
+        for (int j=0; j<3; j++)
+            if (format[j] == 'r')
+                uses[operands[j]] += weights[i];
+    }
+
+    int gprs = 0, xmms = 0;
+    for (;;) {
+        int best = -1;
+        for (int r=0; r<p->constant_base; r++) {
+            bool fits = (ctx->classes[r] == CLASS_INTEGER && gprs < GPR_COUNT) ||
+                        (ctx->classes[r] == CLASS_REAL && xmms < XMM_COUNT && !calls);
+            if (ctx->locations[r].kind == 0 && uses[r] > 0 && fits && (best < 0 || uses[r] > uses[best]))
+                best = r;
+        }
+        if (best < 0)
+            break;
+
+        if (ctx->classes[best] == CLASS_INTEGER) {
+            ctx->locations[best].kind = LOCATION_GPR;
+            ctx->locations[best].index = gprs++;
+        } else {
+            ctx->locations[best].kind = LOCATION_XMM;
+            ctx->locations[best].index = xmms++;
+        }
+    }
+    ctx->used_gprs = gprs;
+
+    int slots = 0;
+    for (int r=0; r<p->constant_base; r++)
+        if (ctx->locations[r].kind == 0) {
+            ctx->locations[r].kind = LOCATION_STACK;
+            ctx->locations[r].index = -8 * (gprs + 1 + slots++);
+        }
+    for (int i=0; i<p->constant_count; i++) {
+        ctx->locations[p->constant_base + i].kind = LOCATION_CONSTANT;
+        ctx->locations[p->constant_base + i].index = i;
+    }
+
+    ctx->frame_size = 8 * slots;
+    if ((ctx->frame_size + 8 * gprs) % 16 != 0)      //Keep the stack aligned to 16 bytes for the calls
+        ctx->frame_size += 8;
+
+    free(weights);
+    free(uses);
+}
+
+//Return the text of a register used as operand of a 32 bits integer instruction.
+// The text is stored in one of a few rotating buffers, so that it can be used more than once in the same fprintf
+const char* integer_operand(native_context* ctx, int reg) {
+    static char buffers[4][32];
+    static int next = 0;
+    char* text = buffers[next++ % 4];
+    location* l = &ctx->locations[reg];
+
+    switch(l->kind) {
+        case LOCATION_GPR:      return gpr_names_32[l->index];
+        case LOCATION_CONSTANT: sprintf(text, "$%d", ctx->p->constants[l->index].i); break;
+        default:                sprintf(text, "%d(%%rbp)", l->index); break;
+    }
+    return text;
+}
+
+//Return the text of a register used as operand of a REAL or 64 bits instruction
+const char* memory_operand(native_context* ctx, int reg) {
+    static char buffers[4][32];
+    static int next = 0;
+    char* text = buffers[next++ % 4];
+    location* l = &ctx->locations[reg];
+
+    switch(l->kind) {
+        case LOCATION_XMM:      return xmm_names[l->index];
+        case LOCATION_CONSTANT: sprintf(text, ".LK%d(%%rip)", l->index); break;
+        default:                sprintf(text, "%d(%%rbp)", l->index); break;
+    }
+    return text;
+}
+
+void load_integer(native_context* ctx, int reg, const char* destination) {
+    fprintf(ctx->out, "\tmovl\t%s, %s\n", integer_operand(ctx, reg), destination);
+}
+
+void store_integer(native_context* ctx, const char* source, int reg) {
+    fprintf(ctx->out, "\tmovl\t%s, %s\n", source, integer_operand(ctx, reg));
+}
+
+void load_real(native_context* ctx, int reg, const char* destination) {
+    fprintf(ctx->out, "\tmovss\t%s, %s\n", memory_operand(ctx, reg), destination);
+}
+
+void store_real(native_context* ctx, const char* source, int reg) {
+    fprintf(ctx->out, "\tmovss\t%s, %s\n", source, memory_operand(ctx, reg));
+}
+
+//Copy a register of any class. When both are in memory, the raw value goes through rax
+void emit_move(native_context* ctx, int destination, int source) {
+    location* from = &ctx->locations[source];
+    location* to = &ctx->locations[destination];
+
+    if (to->kind == LOCATION_GPR && from->kind != LOCATION_XMM)
+        load_integer(ctx, source, gpr_names_32[to->index]);
+    else if (from->kind == LOCATION_GPR && to->kind == LOCATION_STACK)
+        store_integer(ctx, gpr_names_32[from->index], destination);
+    else if (to->kind == LOCATION_XMM)
+        load_real(ctx, source, xmm_names[to->index]);
+    else if (from->kind == LOCATION_XMM)
+        store_real(ctx, xmm_names[from->index], destination);
+    else {
+        fprintf(ctx->out, "\tmovq\t%s, %%rax\n", memory_operand(ctx, source));
+        fprintf(ctx->out, "\tmovq\t%%rax, %s\n", memory_operand(ctx, destination));
+    }
+}
+
+//Emit a two operands instruction computing 'a = b <operation> c'. When 'a' is kept in a machine register
+// the result is computed directly there (so 'i = i + 1' becomes a single addl), otherwise in 'scratch'
+void emit_binary(native_context* ctx, instr* in, const char* operation, bool real, const char* scratch) {
+    location* l = &ctx->locations[in->a];
+    const char* target = scratch;
+
+    if (in->a != in->c && l->kind == (real ? LOCATION_XMM : LOCATION_GPR))
+        target = real ? xmm_names[l->index] : gpr_names_32[l->index];
+
+    if (target == scratch || in->a != in->b) {
+        if (real)
+            load_real(ctx, in->b, target);
+        else
+            load_integer(ctx, in->b, target);
+    }
+    fprintf(ctx->out, "\t%s\t%s, %s\n", operation, real ? memory_operand(ctx, in->c) : integer_operand(ctx, in->c), target);
+
+    if (target == scratch) {
+        if (real)
+            store_real(ctx, scratch, in->a);
+        else
+            store_integer(ctx, scratch, in->a);
+    }
+}
+
+//Return the condition code ("l" for jl/setl...) of a comparison opcode. Integers and strings (compared through the
+// result of strcmp) use signed conditions, while REAL use the unsigned ones set by ucomiss. An unordered comparison (with
+// a NaN) sets ZF, PF and CF together: < and <= are tested as > and >= with swapped operands (see emit_compare), so that
+// they are false on NaN as in C, and == also checks PF (see emit_real_equality)
+const char* get_condition_code(int op, bool negate) {
+    static const char* signed_codes[] = { "e", "ge", "le", "g", "l" };
+    static const char* signed_negated[] = { "ne", "l", "g", "le", "ge" };
+    static const char* real_codes[] = { "e", "ae", "ae", "a", "a" };
+    static const char* real_negated[] = { "ne", "b", "b", "be", "be" };
+    int position = (op - OP_EQ_I) % 5;
+
+    if (op >= OP_EQ_F && op <= OP_LT_F)
+        return negate ? real_negated[position] : real_codes[position];
+    return negate ? signed_negated[position] : signed_codes[position];
+}
+
+//Emit the comparison setting the flags for a compare opcode
+void emit_compare(native_context* ctx, instr* in) {
+    if (in->op >= OP_EQ_F && in->op <= OP_LT_F) {
+        bool swap = (in->op == OP_LE_F || in->op == OP_LT_F);
+        load_real(ctx, swap ? in->c : in->b, "%xmm0");
+        fprintf(ctx->out, "\tucomiss\t%s, %%xmm0\n", memory_operand(ctx, swap ? in->b : in->c));
+    } else if (in->op >= OP_EQ_S && in->op <= OP_LT_S) {
+        fprintf(ctx->out, "\tmovq\t%s, %%rdi\n", memory_operand(ctx, in->b));
+        fprintf(ctx->out, "\tmovq\t%s, %%rsi\n", memory_operand(ctx, in->c));
+        fprintf(ctx->out, "\tcall\tstrcmp@PLT\n");
+        fprintf(ctx->out, "\tcmpl\t$0, %%eax\n");
+    } else {
+        const char* first = "%eax";
+        if (ctx->locations[in->b].kind == LOCATION_GPR)
+            first = integer_operand(ctx, in->b);
+        else
+            load_integer(ctx, in->b, first);
+        fprintf(ctx->out, "\tcmpl\t%s, %s\n", integer_operand(ctx, in->c), first);
+    }
+}
+
+//Emit the use of the flags of a REAL ==, which holds when ZF is set and PF is not: the result in eax, or a branch to
+// 'target' taken when the result is equal to 'jump_if'
+void emit_real_equality(native_context* ctx, int position, int target, bool jump_if) {
+    if (target < 0) {
+        fprintf(ctx->out, "\tsete\t%%al\n\tsetnp\t%%cl\n\tandb\t%%cl, %%al\n");
+        fprintf(ctx->out, "\tmovzbl\t%%al, %%eax\n");
+    } else if (jump_if) {
+        fprintf(ctx->out, "\tjp\t.Lordered%d\n\tje\t.L%d\n.Lordered%d:\n", position, target, position);
+    } else
+        fprintf(ctx->out, "\tjp\t.L%d\n\tjne\t.L%d\n", target, target);
+}
+
+//Emit the check of the divisor (in ecx, or xmm1 for REAL), jumping to the error routine with the line in edx when it is zero
+void emit_division_check(native_context* ctx, int position, bool real) {
+    if (real) {
+        fprintf(ctx->out, "\txorps\t%%xmm2, %%xmm2\n");
+        fprintf(ctx->out, "\tucomiss\t%%xmm2, %%xmm1\n");
+        fprintf(ctx->out, "\tjp\t.Lcheck%d\n", position);       //A NaN is not 0
+    } else
+        fprintf(ctx->out, "\ttestl\t%%ecx, %%ecx\n");
+
+    fprintf(ctx->out, "\tjne\t.Lcheck%d\n", position);
+    fprintf(ctx->out, "\tmovl\t$%d, %%edx\n", ctx->p->lines[position]);
+    fprintf(ctx->out, "\tjmp\t.Ldivision_by_zero\n");
+    fprintf(ctx->out, ".Lcheck%d:\n", position);
+}
+
+//Emit the indirect jump of a switch through its table (see emit_constants), which holds the offsets of the targets
+// from the table itself, so that the code is position independent
+void emit_switch(native_context* ctx, instr* in) {
+    switch_table* t = &ctx->p->tables[in->b];
+
+    if (in->op == OP_SWITCH_S) {
+        fprintf(ctx->out, "\tmovq\t%s, %%rax\n", memory_operand(ctx, in->a));
+        fprintf(ctx->out, "\tmovl\t-4(%%rax), %%eax\n");         //Hash, in the string_header before the text
+        fprintf(ctx->out, "\tandl\t$%d, %%eax\n", t->count - 1);
+    } else {
+        load_integer(ctx, in->a, "%eax");
+        if (t->low != 0)
+            fprintf(ctx->out, "\tsubl\t$%d, %%eax\n", t->low);
+        fprintf(ctx->out, "\tcmpl\t$%d, %%eax\n\tjae\t.L%d\n", t->count, t->default_target);     //Unsigned: also below 'low'
+    }
+    fprintf(ctx->out, "\tleaq\t.LT%d(%%rip), %%rdx\n", in->b);
+    fprintf(ctx->out, "\tmovslq\t(%%rdx,%%rax,4), %%rax\n");
+    fprintf(ctx->out, "\taddq\t%%rdx, %%rax\n\tjmp\t*%%rax\n");
+}
+
+//Translate one instruction. Return the number of instructions consumed, since a comparison
+// followed by a conditional jump on its result is translated as a single compare and branch
+int emit_instruction(native_context* ctx, int position) {
+    program* p = ctx->p;
+    instr* in = &p->code[position];
+    static const char* integer_operations[] = { "addl", "subl", "imull" };
+    static const char* real_operations[] = { "addss", "subss", "mulss", "divss" };
+
+    switch(in->op) {
+        case OP_MOV:
+            emit_move(ctx, in->a, in->b);
+            break;
+        case OP_I2F:
+            load_integer(ctx, in->b, "%eax");
+            fprintf(ctx->out, "\tcvtsi2ssl\t%%eax, %%xmm0\n");
+            store_real(ctx, "%xmm0", in->a);
+            break;
+
+        case OP_ADD_I: case OP_SUB_I: case OP_MUL_I:
+            emit_binary(ctx, in, integer_operations[in->op - OP_ADD_I], false, "%eax");
+            break;
+        case OP_DIV_I: case OP_MOD_I:       //idivl traps on INT_MIN / -1: a divisor of -1 negates instead, as in vm.c
+            load_integer(ctx, in->c, "%ecx");
+            emit_division_check(ctx, position, false);
+            load_integer(ctx, in->b, "%eax");
+            fprintf(ctx->out, "\tcmpl\t$-1, %%ecx\n\tjne\t.Ldivide%d\n", position);
+            fprintf(ctx->out, "\tnegl\t%%eax\n\txorl\t%%edx, %%edx\n\tjmp\t.Ldivided%d\n", position);
+            fprintf(ctx->out, ".Ldivide%d:\n\tcltd\n\tidivl\t%%ecx\n.Ldivided%d:\n", position, position);
+            store_integer(ctx, (in->op == OP_DIV_I) ? "%eax" : "%edx", in->a);
+            break;
+
+        case OP_DIV_F:
+            load_real(ctx, in->c, "%xmm1");
+            emit_division_check(ctx, position, true);
+            load_real(ctx, in->b, "%xmm0");
+            fprintf(ctx->out, "\tdivss\t%%xmm1, %%xmm0\n");
+            store_real(ctx, "%xmm0", in->a);
+            break;
+        case OP_ADD_F: case OP_SUB_F: case OP_MUL_F:
+            emit_binary(ctx, in, real_operations[in->op - OP_ADD_F], true, "%xmm0");
+            break;
+
+        case OP_AND: case OP_OR:
+            emit_binary(ctx, in, (in->op == OP_AND) ? "andl" : "orl", false, "%eax");
+            break;
+        case OP_NOT:
+            load_integer(ctx, in->b, "%eax");
+            fprintf(ctx->out, "\txorl\t$1, %%eax\n");
+            store_integer(ctx, "%eax", in->a);
+            break;
+
+        case OP_JMP:
+            fprintf(ctx->out, "\tjmp\t.L%d\n", in->a);
+            break;
+        case OP_JZ: case OP_JNZ:
+            load_integer(ctx, in->a, "%eax");
+            fprintf(ctx->out, "\ttestl\t%%eax, %%eax\n");
+            fprintf(ctx->out, "\t%s\t.L%d\n", (in->op == OP_JZ) ? "jz" : "jnz", in->b);
+            break;
+        case OP_SWITCH_I: case OP_SWITCH_C: case OP_SWITCH_S:
+            emit_switch(ctx, in);
+            break;
+
+        case OP_RET:
+            if (p->result_type == REAL_TYPE) {
+                load_real(ctx, p->result, "%xmm0");
+                fprintf(ctx->out, "\tcvttss2si\t%%xmm0, %%eax\n");
+            } else if (p->result_type != UNKNOWN_TYPE && p->result_type != STRING_TYPE)
+                load_integer(ctx, p->result, "%eax");
+            else
+                fprintf(ctx->out, "\txorl\t%%eax, %%eax\n");
+            if (position + 1 < p->length)
+                fprintf(ctx->out, "\tjmp\t.Lreturn\n");
+            break;
+
+        default:            //Comparisons
+            emit_compare(ctx, in);
+
+            //The result of the comparison is a temporary tested only by the next jump: branch on the flags directly
+            instr* next = (position + 1 < p->length) ? &p->code[position + 1] : NULL;
+            if (next != NULL && (next->op == OP_JZ || next->op == OP_JNZ) && next->a == in->a
+                    && in->a >= p->variable_count && !ctx->targets[position + 1]) {
+                if (in->op == OP_EQ_F)
+                    emit_real_equality(ctx, position, next->b, next->op == OP_JNZ);
+                else
+                    fprintf(ctx->out, "\tj%s\t.L%d\n", get_condition_code(in->op, next->op == OP_JZ), next->b);
+                return 2;
+            }
+
+            if (in->op == OP_EQ_F)
+                emit_real_equality(ctx, position, -1, false);
+            else {
+                fprintf(ctx->out, "\tset%s\t%%al\n", get_condition_code(in->op, false));
+                fprintf(ctx->out, "\tmovzbl\t%%al, %%eax\n");
+            }
+            store_integer(ctx, "%eax", in->a);
+            break;
+    }
+    return 1;
+}
+
+//Write a string literal escaping the characters not allowed between quotes
+void emit_string(FILE* out, char* s) {
+    fprintf(out, "\t.string\t\"");
+    for (; *s != '\0'; s++) {
+        if (*s == '"' || *s == '\\')
+            fprintf(out, "\\%c", *s);
+        else if (*s == '\n')
+            fprintf(out, "\\n");
+        else
+            fputc(*s, out);
+    }
+    fprintf(out, "\"\n");
+}
+
+//Write the constants of the program: 8 bytes each, so that any of them can be moved with a single movq
+void emit_constants(native_context* ctx) {
+    program* p = ctx->p;
+
+    fprintf(ctx->out, "\n\t.section\t.data.rel.ro.local,\"aw\"\n");     //Not .rodata, since string constants hold relocated pointers
+    fprintf(ctx->out, ".Ldivision_message:\n");
+    emit_string(ctx->out, "\nFatal error on line %d: Division by 0\n");
+    string_header* empty = STRING_HEADER(p->empty_string);     //Initial content of the STRING variables
+    fprintf(ctx->out, "\t.align\t4\n\t.long\t%u, %u\n", empty->length, empty->hash);
+    fprintf(ctx->out, ".Lempty:\n");
+    emit_string(ctx->out, "");
+
+    fprintf(ctx->out, "\t.align\t8\n");
+    for (int i=0; i<p->constant_count; i++) {
+        values* v = &p->constants[i];
+        unsigned bits;
+
+        fprintf(ctx->out, ".LK%d:\n", i);
+        switch(p->constant_types[i]) {
+            case REAL_TYPE:
+                memcpy(&bits, &v->f, sizeof(bits));
+                fprintf(ctx->out, "\t.long\t0x%08x, 0\t\t# %g\n", bits, v->f);
+                break;
+            case STRING_TYPE:
+                fprintf(ctx->out, "\t.quad\t.LS%d\n", i);
+                break;
+            case CHAR_TYPE:
+                fprintf(ctx->out, "\t.long\t%d, 0\n", v->c);
+                break;
+            case BOOL_TYPE:
+                fprintf(ctx->out, "\t.long\t%d, 0\n", v->b ? 1 : 0);
+                break;
+            default:
+                fprintf(ctx->out, "\t.long\t%d, 0\n", v->i);
+                break;
+        }
+    }
+    for (int i=0; i<p->constant_count; i++)
+        if (p->constant_types[i] == STRING_TYPE) {         //Preceded by their string_header, as in the compiler
+            string_header* header = STRING_HEADER(p->constants[i].s);
+            fprintf(ctx->out, "\t.align\t4\n\t.long\t%u, %u\n", header->length, header->hash);
+            fprintf(ctx->out, ".LS%d:\n", i);
+            emit_string(ctx->out, p->constants[i].s);
+        }
+
+    fprintf(ctx->out, "\t.align\t4\n");
+    for (int i=0; i<p->table_count; i++) {
+        fprintf(ctx->out, ".LT%d:\n", i);
+        for (int k=0; k<p->tables[i].count; k++)
+            fprintf(ctx->out, "\t.long\t.L%d-.LT%d\n", p->tables[i].targets[k], i);
+    }
+}
+
+//Write the assembly of the whole program to 'out'
+void emit_assembly(program* p, FILE* out) {
+    native_context ctx;
+    ctx.p = p;
+    ctx.out = out;
+    ctx.locations = calloc(p->register_count, sizeof(location));
+    ctx.classes = calloc(p->register_count, sizeof(int));
+    ctx.targets = calloc(p->length + 1, sizeof(bool));
+
+    //CHAR and BOOL constants are stored as 32 bits integers, so that they can be used as immediates
+    for (int i=0; i<p->constant_count; i++) {
+        if (p->constant_types[i] == CHAR_TYPE)
+            p->constants[i].i = p->constants[i].c;
+        else if (p->constant_types[i] == BOOL_TYPE)
+            p->constants[i].i = p->constants[i].b ? 1 : 0;
+    }
+
+    classify_registers(&ctx);
+    allocate_registers(&ctx);
+
+    fprintf(out, "# Generated by the compiler of the Formal Languages and Compilers project\n");
+    fprintf(out, "\t.text\n\t.globl\tmain\n\t.type\tmain, @function\nmain:\n");
+    fprintf(out, "\tpushq\t%%rbp\n\tmovq\t%%rsp, %%rbp\n");
+    for (int i=0; i<ctx.used_gprs; i++)
+        fprintf(out, "\tpushq\t%s\n", gpr_names_64[i]);
+    if (ctx.frame_size > 0)
+        fprintf(out, "\tsubq\t$%d, %%rsp\n", ctx.frame_size);
+    if (p->string_register_count > 0) {         //STRING variables hold the empty string until they are assigned
+        fprintf(out, "\tleaq\t.Lempty(%%rip), %%rax\n");
+        for (int i=0; i<p->string_register_count; i++)
+            fprintf(out, "\tmovq\t%%rax, %s\n", memory_operand(&ctx, p->string_registers[i]));
+    }
+
+    for (int i=0; i<p->length; ) {
+        if (ctx.targets[i])
+            fprintf(out, ".L%d:\n", i);
+        fprintf(out, "\t# %s line %d\n", opcode_names[p->code[i].op] + 3, p->lines[i]);
+        i += emit_instruction(&ctx, i);
+    }
+    if (ctx.targets[p->length])
+        fprintf(out, ".L%d:\n", p->length);
+
+    fprintf(out, ".Lreturn:\n");
+    fprintf(out, "\tleaq\t%d(%%rbp), %%rsp\n", -8 * ctx.used_gprs);
+    for (int i=ctx.used_gprs - 1; i>=0; i--)
+        fprintf(out, "\tpopq\t%s\n", gpr_names_64[i]);
+    fprintf(out, "\tpopq\t%%rbp\n\tret\n");
+
+    fprintf(out, ".Ldivision_by_zero:\n");      //Line number in edx
+    fprintf(out, "\tmovl\t$2, %%edi\n\tleaq\t.Ldivision_message(%%rip), %%rsi\n\txorl\t%%eax, %%eax\n");
+    fprintf(out, "\tcall\tdprintf@PLT\n\tmovl\t$1, %%edi\n\tcall\texit@PLT\n");
+    fprintf(out, "\t.size\tmain, .-main\n");
+
+    emit_constants(&ctx);
+    fprintf(out, "\t.section\t.note.GNU-stack,\"\",@progbits\n");
+
+    free(ctx.locations);
+    free(ctx.classes);
+    free(ctx.targets);
+}
+
+//Write the program as an ELF object, assembling the generated code with the system assembler. The assembler is started
+// without a shell and reads the code from a pipe, so the path reaches it as a single argument, whatever it contains.
+// SIGPIPE is ignored while writing: an assembler that stops early (e.g. on a path it cannot write) only fails the writes,
+// and its exit status is reported
+int write_object(program* p, char* path) {
+    int channel[2];
+    if (pipe(channel) != 0)
+        return -1;
+
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_adddup2(&actions, channel[0], STDIN_FILENO);
+    posix_spawn_file_actions_addclose(&actions, channel[0]);
+    posix_spawn_file_actions_addclose(&actions, channel[1]);
+
+    char* arguments[] = { "as", "--64", "-o", path, NULL };
+    pid_t assembler;
+    int failed = posix_spawnp(&assembler, "as", &actions, NULL, arguments, environ);
+    posix_spawn_file_actions_destroy(&actions);
+    close(channel[0]);
+    if (failed != 0) {
+        close(channel[1]);
+        return -1;
+    }
+
+    struct sigaction ignore, previous;
+    memset(&ignore, 0, sizeof(ignore));
+    ignore.sa_handler = SIG_IGN;
+    sigaction(SIGPIPE, &ignore, &previous);
+
+    FILE* code = fdopen(channel[1], "w");
+    if (code != NULL) {
+        emit_assembly(p, code);
+        fclose(code);
+    } else
+        close(channel[1]);          //The assembler ends on an empty input, and the failure is reported after it
+    sigaction(SIGPIPE, &previous, NULL);
+
+    int status;
+    if (waitpid(assembler, &status, 0) < 0 || !WIFEXITED(status))
+        return -1;
+    return (code != NULL) ? WEXITSTATUS(status) : -1;
+}
@@ -0,0 +1,121 @@
+#include <stdio.h>
+#include <string.h>
+#include "y.tab.h"
+#include "bytecode.h"
+#include "operators.h"
+
+/* Table of the operators, with the functions computing them on constants. Check structs declaration in operators.h */
+
+_Static_assert(ASSIGN - PLUS == 13, "Operator tokens must be declared contiguously in yacc.y, from PLUS to ASSIGN");
+
+
+// Functions folding an operation on constants, one for each operator and operand type
+//-------------------------------------------------------------------------------------
+
+//INT arithmetic works on unsigned values, so that overflows wrap around like the machine instructions
+#define INT_KERNEL(name, operator) \
+    bool fold_##name##_i(values* x, values* y, values* result) { result->i = (int) ((unsigned) x->i operator (unsigned) y->i); return true; }
+#define REAL_KERNEL(name, operator) \
+    bool fold_##name##_f(values* x, values* y, values* result) { result->f = x->f operator y->f; return true; }
+
+INT_KERNEL(add, +)
+INT_KERNEL(sub, -)
+INT_KERNEL(mul, *)
+REAL_KERNEL(add, +)
+REAL_KERNEL(sub, -)
+REAL_KERNEL(mul, *)
+
+//Divisions by 0 are not folded: the virtual machine reports them. INT_MIN / -1 overflows: its quotient wraps around to
+// INT_MIN and its remainder is 0, as in the virtual machine (see vm.c)
+bool fold_div_i(values* x, values* y, values* result) {
+    if (y->i == 0)
+        return false;
+    result->i = (y->i == -1) ? (int) (0u - (unsigned) x->i) : x->i / y->i;
+    return true;
+}
+
+bool fold_mod_i(values* x, values* y, values* result) {
+    if (y->i == 0)
+        return false;
+    result->i = (y->i == -1) ? 0 : x->i % y->i;
+    return true;
+}
+
+bool fold_div_f(values* x, values* y, values* result) {
+    if (y->f == 0)
+        return false;
+    result->f = x->f / y->f;
+    return true;
+}
+
+bool fold_and(values* x, values* y, values* result) { result->b = x->b && y->b; return true; }
+bool fold_or(values* x, values* y, values* result)  { result->b = x->b || y->b; return true; }
+bool fold_not(values* x, values* y, values* result) { (void) y; result->b = !x->b; return true; }
+
+//Comparisons read the member of their own operand type, exactly like the instructions of the virtual machine
+#define COMPARE_KERNELS(name, operator)                                                                                         \
+    bool fold_##name##_i(values* x, values* y, values* result) { result->b = x->i operator y->i; return true; }                \
+    bool fold_##name##_f(values* x, values* y, values* result) { result->b = x->f operator y->f; return true; }                \
+    bool fold_##name##_c(values* x, values* y, values* result) { result->b = x->c operator y->c; return true; }                \
+    bool fold_##name##_b(values* x, values* y, values* result) { result->b = x->b operator y->b; return true; }                \
+    bool fold_##name##_s(values* x, values* y, values* result) { result->b = compare_strings(x->s, y->s) operator 0; return true; }
+
+COMPARE_KERNELS(eq, ==)
+COMPARE_KERNELS(ge, >=)
+COMPARE_KERNELS(le, <=)
+COMPARE_KERNELS(gt, >)
+COMPARE_KERNELS(lt, <)
+
+
+// Table of the operators
+//-------------------------------------------------------------------------------------
+
+//Rules of an arithmetical operator: INT with INT gives INT, any other mix of INT and REAL gives REAL
+#define ARITHMETIC_RULES(token, opcode, kernel)                                                 \
+    [token - PLUS][INT_TYPE][INT_TYPE]   = { INT_TYPE, INT_TYPE, opcode##_I, fold_##kernel##_i },  \
+    [token - PLUS][INT_TYPE][REAL_TYPE]  = { REAL_TYPE, REAL_TYPE, opcode##_F, fold_##kernel##_f }, \
+    [token - PLUS][REAL_TYPE][INT_TYPE]  = { REAL_TYPE, REAL_TYPE, opcode##_F, fold_##kernel##_f }, \
+    [token - PLUS][REAL_TYPE][REAL_TYPE] = { REAL_TYPE, REAL_TYPE, opcode##_F, fold_##kernel##_f },
+
+//Rules of a comparison: operands of the same type, or a mix of INT and REAL, give a BOOL
+#define COMPARISON_RULES(token, opcode, kernel)                                                     \
+    [token - PLUS][INT_TYPE][INT_TYPE]       = { BOOL_TYPE, INT_TYPE, opcode##_I, fold_##kernel##_i },    \
+    [token - PLUS][INT_TYPE][REAL_TYPE]      = { BOOL_TYPE, REAL_TYPE, opcode##_F, fold_##kernel##_f },   \
+    [token - PLUS][REAL_TYPE][INT_TYPE]      = { BOOL_TYPE, REAL_TYPE, opcode##_F, fold_##kernel##_f },   \
+    [token - PLUS][REAL_TYPE][REAL_TYPE]     = { BOOL_TYPE, REAL_TYPE, opcode##_F, fold_##kernel##_f },   \
+    [token - PLUS][CHAR_TYPE][CHAR_TYPE]     = { BOOL_TYPE, CHAR_TYPE, opcode##_C, fold_##kernel##_c },   \
+    [token - PLUS][BOOL_TYPE][BOOL_TYPE]     = { BOOL_TYPE, BOOL_TYPE, opcode##_B, fold_##kernel##_b },   \
+    [token - PLUS][STRING_TYPE][STRING_TYPE] = { BOOL_TYPE, STRING_TYPE, opcode##_S, fold_##kernel##_s },
+
+//Rule of an assignment: the value must have the same type of the variable
+#define ASSIGN_RULE(type) [ASSIGN - PLUS][type][type] = { type, type, OP_MOV, NULL },
+
+//Every combination not listed is zero, so its result type is UNKNOWN_TYPE: a type conflict
+const operator_rule operator_rules[OPERATOR_COUNT][TYPE_COUNT][TYPE_COUNT] = {
+    ARITHMETIC_RULES(PLUS, OP_ADD, add)
+    ARITHMETIC_RULES(MINUS, OP_SUB, sub)
+    ARITHMETIC_RULES(MUL, OP_MUL, mul)
+    ARITHMETIC_RULES(DIV, OP_DIV, div)
+    [MOD - PLUS][INT_TYPE][INT_TYPE]   = { INT_TYPE, INT_TYPE, OP_MOD_I, fold_mod_i },
+
+    [AND - PLUS][BOOL_TYPE][BOOL_TYPE] = { BOOL_TYPE, BOOL_TYPE, OP_AND, fold_and },
+    [OR - PLUS][BOOL_TYPE][BOOL_TYPE]  = { BOOL_TYPE, BOOL_TYPE, OP_OR, fold_or },
+    [NOT - PLUS][BOOL_TYPE][BOOL_TYPE] = { BOOL_TYPE, BOOL_TYPE, OP_NOT, fold_not },    //The operand of NOT is given as both operands
+
+    COMPARISON_RULES(EQUAL, OP_EQ, eq)
+    COMPARISON_RULES(GEQ, OP_GE, ge)
+    COMPARISON_RULES(SEQ, OP_LE, le)
+    COMPARISON_RULES(GREATER, OP_GT, gt)
+    COMPARISON_RULES(SMALLER, OP_LT, lt)
+
+    ASSIGN_RULE(INT_TYPE)
+    ASSIGN_RULE(REAL_TYPE)
+    ASSIGN_RULE(CHAR_TYPE)
+    ASSIGN_RULE(STRING_TYPE)
+    ASSIGN_RULE(BOOL_TYPE)
+};
+
+//Return the rule of an operator token applied to operands of the given types
+const operator_rule* get_operator_rule(int operation_type, int first_type, int second_type) {
+    return &operator_rules[operation_type - PLUS][first_type][second_type];
+}
@@ -0,0 +1,33 @@
+#ifndef OPERATORS_H
+#define OPERATORS_H
+
+#include <stdbool.h>
+#include "sym_table.h"
+
+/* Rules of the operators, in a table indexed by operator and by the data types of the two operands.
+   Each entry gives everything the compiler has to know about an operation: the type of its result (UNKNOWN_TYPE if the
+   operator cannot be applied to those types), the type its operands are converted to, the instruction computing it,
+   and a function computing it on constants. The table is initialized at compile time (see operators.c), so type
+   checking, translation to bytecode and constant folding all get their answer from a single indexed access */
+
+//Operator tokens, from PLUS to ASSIGN, are declared contiguously in yacc.y: 'operator - PLUS' indexes the table
+#define OPERATOR_COUNT (ASSIGN - PLUS + 1)
+
+//Compute an operation on constants, as the virtual machine would. 'y' is NULL for NOT.
+// Return false when the result cannot be computed at compile time (the operation would stop the program)
+typedef bool (*fold_function)(values* x, values* y, values* result);
+
+//Struct defining how an operator works on operands of two given types
+typedef struct operator_rule {
+    int result_type;        //Data type of the result, UNKNOWN_TYPE if the operands are not valid for the operator
+    int operand_type;       //Data type of both operands during the operation: INT operands mixed with REAL ones are converted
+    int opcode;             //Instruction of the virtual machine (see bytecode.h)
+    fold_function fold;     //NULL for ASSIGN, which is never folded
+} operator_rule;
+
+
+//Function signatures, see operators.c for implementation
+
+const operator_rule* get_operator_rule(int operation_type, int first_type, int second_type);
+
+#endif
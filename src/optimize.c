@@ -0,0 +1,469 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bytecode.h"
+#include "compilation.h"
+#include "operators.h"
+
+/* Optimization passes, run between parsing and execution (or native code generation):
+    - on the abstract syntax tree: constant folding, algebraic simplification and removal of dead branches
+    - on the bytecode: common subexpression elimination and copy propagation inside each basic block,
+      followed by the removal of the instructions whose result is never used
+   Operations that may fail at runtime (divisions) are never folded nor dropped, so errors are still reported */
+
+
+//Return whether evaluating an expression may stop the program (division by 0)
+bool can_fail(node* n) {
+    if (n == NULL || n->kind == NODE_CONSTANT || n->kind == NODE_VARIABLE)
+        return false;
+    if (n->kind == NODE_OPERATION && (n->op == DIV || n->op == MOD))
+        return true;
+    return can_fail(n->left) || can_fail(n->right);
+}
+
+bool is_constant(node* n, int type, int value) {
+    if (n->kind != NODE_CONSTANT || n->type != type)
+        return false;
+
+    switch(type) {
+        case INT_TYPE:  return n->value.i == value;
+        case REAL_TYPE: return n->value.f == value;
+        case BOOL_TYPE: return n->value.b == value;
+        default:        return false;
+    }
+}
+
+//Turn a node into a constant, in place
+void make_constant(node* n, int type, values* value) {
+    n->kind = NODE_CONSTANT;
+    n->type = type;
+    n->value = *value;
+    n->left = n->right = NULL;
+    context->folded_nodes++;
+}
+
+//Return a simpler expression equivalent to an operation whose operands are already optimized, or NULL if there is none
+node* simplify_operation(node* n) {
+    node* left = n->left;
+    node* right = n->right;
+    int type = left->type;
+
+    if (type != INT_TYPE && type != REAL_TYPE && type != BOOL_TYPE)
+        return NULL;
+
+    switch(n->op) {
+        case PLUS:          //Only for INT: with REAL, -0.0 + 0.0 is not -0.0
+            if (is_constant(left, INT_TYPE, 0))
+                return right;
+            if (is_constant(right, INT_TYPE, 0))
+                return left;
+            break;
+        case MINUS:
+            if (is_constant(right, INT_TYPE, 0))
+                return left;
+            break;
+        case MUL:
+            if (is_constant(left, type, 1))
+                return right;
+            if (is_constant(right, type, 1))
+                return left;
+            if ((is_constant(left, INT_TYPE, 0) && !can_fail(right)) || (is_constant(right, INT_TYPE, 0) && !can_fail(left)))
+                return is_constant(left, INT_TYPE, 0) ? left : right;
+            break;
+        case DIV:
+            if (is_constant(right, type, 1))
+                return left;
+            break;
+        case AND:           //Both operands are always evaluated, so one can be dropped only if it cannot fail
+            if (is_constant(left, BOOL_TYPE, true))
+                return right;
+            if (is_constant(right, BOOL_TYPE, true))
+                return left;
+            if (is_constant(left, BOOL_TYPE, false) && !can_fail(right))
+                return left;
+            if (is_constant(right, BOOL_TYPE, false) && !can_fail(left))
+                return right;
+            break;
+        case OR:
+            if (is_constant(left, BOOL_TYPE, false))
+                return right;
+            if (is_constant(right, BOOL_TYPE, false))
+                return left;
+            if (is_constant(left, BOOL_TYPE, true) && !can_fail(right))
+                return left;
+            if (is_constant(right, BOOL_TYPE, true) && !can_fail(left))
+                return right;
+            break;
+        case NOT:
+            if (left->kind == NODE_OPERATION && left->op == NOT)
+                return left->left;
+            break;
+    }
+    return NULL;
+}
+
+//Optimize an expression, returning the node that replaces it
+node* optimize_expression(node* n) {
+    values result;
+    node* simpler;
+
+    switch(n->kind) {
+        case NODE_CONVERT:
+            n->left = optimize_expression(n->left);
+            if (n->left->kind == NODE_CONSTANT) {
+                memset(&result, 0, sizeof(values));
+                result.f = n->left->value.i;
+                make_constant(n, REAL_TYPE, &result);
+            }
+            break;
+
+        case NODE_OPERATION:
+            n->left = optimize_expression(n->left);
+            if (n->right != NULL)
+                n->right = optimize_expression(n->right);
+
+            if (n->left->kind == NODE_CONSTANT && (n->right == NULL || n->right->kind == NODE_CONSTANT)) {
+                fold_function fold = get_operator_rule(n->op, n->left->type, n->left->type)->fold;     //Operands have the same type
+                memset(&result, 0, sizeof(values));
+                if (fold(&n->left->value, (n->right != NULL) ? &n->right->value : NULL, &result))
+                    make_constant(n, n->type, &result);
+            } else if ((simpler = simplify_operation(n)) != NULL) {
+                context->folded_nodes++;
+                return simpler;
+            }
+            break;
+    }
+    return n;
+}
+
+//Optimize a statement, returning the statement that replaces it (NULL if it can be dropped)
+node* optimize_statement(node* n) {
+    node *c, *previous;
+
+    if (n == NULL)
+        return NULL;
+
+    switch(n->kind) {
+        case NODE_BLOCK:
+            previous = NULL;
+            for (c = n->first; c != NULL; c = c->next) {
+                node* next = c->next;
+                node* optimized = optimize_statement(c);
+
+                if (optimized == NULL) {
+                    if (previous == NULL)
+                        n->first = next;
+                    else
+                        previous->next = next;
+                    continue;
+                }
+                optimized->next = next;
+                if (previous == NULL)
+                    n->first = optimized;
+                else
+                    previous->next = optimized;
+                previous = optimized;
+            }
+            n->last = previous;
+            return n;
+
+        case NODE_ASSIGN:
+            n->left = optimize_expression(n->left);
+            return n;
+
+        case NODE_IF:
+            n->condition = optimize_expression(n->condition);
+            n->body = optimize_statement(n->body);
+            if (n->else_body != NULL)
+                n->else_body = optimize_statement(n->else_body);
+
+            if (n->condition->kind == NODE_CONSTANT) {
+                context->removed_branches++;
+                return n->condition->value.b ? n->body : n->else_body;
+            }
+            return n;
+
+        case NODE_WHILE:
+        case NODE_FOR:
+            n->condition = optimize_expression(n->condition);
+            if (is_constant(n->condition, BOOL_TYPE, false)) {       //The body is never executed
+                context->removed_branches++;
+                return n->init;
+            }
+            n->body = optimize_statement(n->body);
+            if (n->step != NULL)
+                n->step = optimize_statement(n->step);
+            return n;
+
+        case NODE_SWITCH:       //The scrutinee is a variable, so no case can be selected before the execution
+            for (c = n->first; c != NULL; c = c->next)
+                c->body = optimize_statement(c->body);
+            if (n->else_body != NULL)
+                n->else_body = optimize_statement(n->else_body);
+            return n;
+    }
+    return n;
+}
+
+//Optimize the statements of the program, and return the optimized expression of its return statement
+node* optimize_tree(node* body, node* result) {
+    context->folded_nodes = 0;
+    context->removed_branches = 0;
+    optimize_statement(body);
+
+    return (result != NULL) ? optimize_expression(result) : NULL;
+}
+
+
+//-----------------------------------------------------------------------------------------------------------------------
+
+//Struct defining an expression already computed in the current basic block.
+// Entries are never deleted: they are valid while none of the registers they refer to has been written again
+typedef struct available_expr {
+    int op;
+    int b;
+    int c;
+    int holder;             //Register holding the value of the expression
+    int block;              //Basic block in which the entry was added
+    int versions[3];        //Number of writes of b, c and holder when the entry was added
+} available_expr;
+
+bool is_switch(int op) {
+    return op == OP_SWITCH_I || op == OP_SWITCH_C || op == OP_SWITCH_S;
+}
+
+bool is_jump(int op) {
+    return op == OP_JMP || op == OP_JZ || op == OP_JNZ || is_switch(op);
+}
+
+bool is_pure_operation(int op) {
+    return op != OP_MOV && !is_jump(op) && op != OP_RET;
+}
+
+bool is_commutative(int op) {
+    return op == OP_ADD_I || op == OP_MUL_I || op == OP_ADD_F || op == OP_MUL_F || op == OP_AND || op == OP_OR ||
+           op == OP_EQ_I || op == OP_EQ_F || op == OP_EQ_C || op == OP_EQ_B || op == OP_EQ_S;
+}
+
+int get_jump_target(instr* in) {
+    return (in->op == OP_JMP) ? in->a : in->b;
+}
+
+//Mark the destinations of the jump at 'position': all the entries of its table for a switch
+void mark_jump_targets(program* p, int position, bool* targets) {
+    instr* in = &p->code[position];
+    if (!is_switch(in->op)) {
+        targets[get_jump_target(in)] = true;
+        return;
+    }
+
+    switch_table* t = &p->tables[in->b];
+    targets[t->default_target] = true;
+    for (int k=0; k<t->count; k++)
+        targets[t->targets[k]] = true;
+}
+
+//Remove the instructions marked in 'removed', moving the jumps to the first instruction kept after their target
+void compact_program(program* p, bool* removed) {
+    int* new_position = malloc((p->length + 1) * sizeof(int));
+    int kept = 0;
+
+    for (int i=0; i<p->length; i++) {
+        new_position[i] = kept;
+        if (!removed[i])
+            kept++;
+    }
+    new_position[p->length] = kept;
+
+    kept = 0;
+    for (int i=0; i<p->length; i++) {
+        if (removed[i])
+            continue;
+        if (is_switch(p->code[i].op)) {       //Every table belongs to a single instruction
+            switch_table* t = &p->tables[p->code[i].b];
+            t->default_target = new_position[t->default_target];
+            for (int k=0; k<t->count; k++)
+                t->targets[k] = new_position[t->targets[k]];
+        } else if (is_jump(p->code[i].op))
+            patch_jump(p, i, new_position[get_jump_target(&p->code[i])]);
+        p->code[kept] = p->code[i];
+        p->lines[kept] = p->lines[i];
+        kept++;
+    }
+    p->length = kept;
+
+    free(new_position);
+}
+
+//Common subexpression elimination and copy propagation. Temporaries never live across basic blocks
+// (see compile_statement), so everything known is forgotten at each jump and jump target.
+// Instead of clearing the state, each register counts its writes, and facts recorded with an older count are ignored
+void propagate_values(program* p, bool* targets) {
+    int* writes = calloc(p->register_count, sizeof(int));
+    int* copy_of = malloc(p->register_count * sizeof(int));        //Register whose value is also in this one
+    int* copy_block = malloc(p->register_count * sizeof(int));     //Block of the copy, valid only in the same block
+    int* copy_version = malloc(p->register_count * sizeof(int));   //Writes of the source register at the time of the copy
+    int capacity = 16, block = 0;
+
+    while (capacity < 2 * p->length)
+        capacity *= 2;
+    available_expr* available = malloc(capacity * sizeof(available_expr));
+    for (int j=0; j<capacity; j++)
+        available[j].block = -1;
+    for (int r=0; r<p->register_count; r++)
+        copy_block[r] = -1;
+
+    #define COPY_OF(r) ((copy_block[r] == block && writes[copy_of[r]] == copy_version[r]) ? copy_of[r] : (r))
+
+    for (int i=0; i<p->length; i++) {
+        instr* in = &p->code[i];
+        const char* format = opcode_formats[in->op];
+
+        if (targets[i])
+            block++;
+
+        //Read the operands from the registers they were copied from
+        if (format[1] == 'r')
+            in->b = COPY_OF(in->b);
+        if (format[2] == 'r')
+            in->c = COPY_OF(in->c);
+        if (in->op == OP_JZ || in->op == OP_JNZ || is_switch(in->op))
+            in->a = COPY_OF(in->a);
+        if (in->op == OP_RET && p->result_type != UNKNOWN_TYPE)
+            p->result = COPY_OF(p->result);
+
+        if (is_jump(in->op) || in->op == OP_RET) {
+            block++;
+            continue;
+        }
+
+        unsigned slot = 0;
+        if (is_pure_operation(in->op)) {
+            if (is_commutative(in->op) && in->b > in->c) {
+                int swap = in->b;
+                in->b = in->c;
+                in->c = swap;
+            }
+
+            slot = ((unsigned) in->op * 31u + (unsigned) in->b * 131071u + (unsigned) in->c * 8191u) & (capacity - 1);
+            for (; available[slot].block == block; slot = (slot + 1) & (capacity - 1)) {
+                available_expr* e = &available[slot];
+                if (e->op == in->op && e->b == in->b && e->c == in->c) {
+                    if (e->versions[0] == writes[e->b] && e->versions[1] == writes[e->c] && e->versions[2] == writes[e->holder]) {
+                        in->op = OP_MOV;        //Already computed: copy it
+                        in->b = e->holder;
+                        in->c = 0;
+                    }
+                    break;
+                }
+            }
+        }
+
+        int a = in->a;
+        writes[a]++;
+        copy_block[a] = -1;
+
+        if (in->op == OP_MOV && in->b != a) {
+            copy_of[a] = in->b;
+            copy_block[a] = block;
+            copy_version[a] = writes[in->b];
+        } else if (in->op != OP_MOV && in->b != a && in->c != a) {
+            available_expr* e = &available[slot];
+            e->op = in->op;
+            e->b = in->b;
+            e->c = in->c;
+            e->holder = a;
+            e->block = block;
+            e->versions[0] = writes[in->b];
+            e->versions[1] = writes[in->c];
+            e->versions[2] = writes[a];
+        }
+    }
+
+    #undef COPY_OF
+
+    free(writes);
+    free(copy_of);
+    free(copy_block);
+    free(copy_version);
+    free(available);
+}
+
+//Mark the instructions writing a temporary that is not read before being overwritten or leaving the block,
+// and the moves of a register into itself. Divisions are kept, since they may stop the program.
+// A register is live if its mark equals the current block number, so nothing has to be cleared between blocks
+int mark_dead_instructions(program* p, bool* targets, bool* removed) {
+    int* live = malloc(p->register_count * sizeof(int));
+    int count = 0, block = 1;
+
+    for (int r=0; r<p->register_count; r++)
+        live[r] = 0;
+
+    for (int i=p->length - 1; i>=0; i--) {
+        instr* in = &p->code[i];
+        const char* format = opcode_formats[in->op];
+
+        if (is_jump(in->op) || in->op == OP_RET || (i + 1 < p->length && targets[i + 1]))
+            block++;        //End of a basic block: no temporary is live
+        if (in->op == OP_RET && p->result_type != UNKNOWN_TYPE)
+            live[p->result] = block;
+
+        bool temporary = in->a >= p->variable_count && in->a < p->constant_base;
+        bool may_fail = in->op == OP_DIV_I || in->op == OP_MOD_I || in->op == OP_DIV_F;
+
+        if ((in->op == OP_MOV && in->a == in->b) ||
+            (!is_jump(in->op) && in->op != OP_RET && temporary && live[in->a] != block && !may_fail)) {
+            removed[i] = true;
+            count++;
+            continue;
+        }
+
+        if (format[0] == 'r')
+            live[in->a] = is_jump(in->op) ? block : 0;
+        if (format[1] == 'r')
+            live[in->b] = block;
+        if (format[2] == 'r')
+            live[in->c] = block;
+    }
+
+    free(live);
+    return count;
+}
+
+//Optimize the bytecode, and return the number of instructions removed
+int optimize_program(program* p) {
+    int initial_length = p->length;
+    bool changed = true;
+
+    while (changed) {
+        bool* targets = calloc(p->length + 1, sizeof(bool));
+        bool* removed = calloc(p->length, sizeof(bool));
+
+        for (int i=0; i<p->length; i++)
+            if (is_jump(p->code[i].op))
+                mark_jump_targets(p, i, targets);
+
+        propagate_values(p, targets);
+        int count = mark_dead_instructions(p, targets, removed);
+
+        for (int i=0; i<p->length; i++) {         //Jumps to the next instruction kept
+            if (removed[i] || p->code[i].op != OP_JMP)
+                continue;
+            int next = i + 1;
+            while (next < p->length && removed[next])
+                next++;
+            if (get_jump_target(&p->code[i]) == next) {
+                removed[i] = true;
+                count++;
+            }
+        }
+
+        compact_program(p, removed);
+        changed = count > 0;
+
+        free(targets);
+        free(removed);
+    }
+
+    return initial_length - p->length;
+}
@@ -0,0 +1,333 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <signal.h>
+#include <sys/time.h>
+#include "bytecode.h"
+#include "profile.h"
+
+/* Execution profiler. Check structs declaration in profile.h */
+
+static execution_profile* volatile sampled_profile = NULL;     //Profile of the execution being sampled by the timer
+
+
+uint64_t monotonic_nanoseconds() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+//Cut the code of the program in segments, and prepare the counters of its execution
+execution_profile* create_profile(program* p) {
+    execution_profile* profile = calloc(1, sizeof(execution_profile));
+    profile->p = p;
+    profile->starts = calloc(p->length + 1, sizeof(bool));
+    profile->ends = malloc((p->length + 1) * sizeof(int));
+    profile->hits = calloc(p->length + 1, sizeof(long));
+    profile->jumps = calloc(p->length + 1, sizeof(long));
+    profile->samples = calloc(p->length + 1, sizeof(long));
+    profile->cycles = calloc(p->length + 1, sizeof(uint64_t));
+
+    profile->starts[0] = true;
+    for (int i=0; i<p->length; i++) {
+        if (is_jump(p->code[i].op))
+            mark_jump_targets(p, i, profile->starts);
+        if (is_jump(p->code[i].op) || p->code[i].op == OP_RET)
+            profile->starts[i + 1] = true;
+        if (i > 0 && p->lines[i] != p->lines[i - 1])
+            profile->starts[i] = true;
+    }
+
+    int end = p->length - 1;
+    for (int i = p->length - 1; i >= 0; i--) {
+        profile->ends[i] = end;
+        if (profile->starts[i])
+            end = i - 1;
+    }
+    profile->ends[p->length] = -1;      //The start of the execution is followed by the first instruction
+    profile->segment = p->length;
+    return profile;
+}
+
+//Handler of SIGPROF: count a sample for the running segment
+void count_profile_sample(int signal) {
+    (void) signal;
+    execution_profile* profile = sampled_profile;
+    if (profile != NULL)
+        profile->samples[profile->segment]++;
+}
+
+//Start the timer sampling the running segment
+void start_profile_sampling(execution_profile* profile) {
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = count_profile_sample;
+    action.sa_flags = SA_RESTART;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGPROF, &action, NULL);
+
+    struct itimerval timer = { { 0, PROFILE_INTERVAL }, { 0, PROFILE_INTERVAL } };
+    sampled_profile = profile;
+    profile->start_cycles = READ_CYCLES();
+    setitimer(ITIMER_PROF, &timer, NULL);
+}
+
+//Stop the timer, and split the cycles of the execution among the segments in proportion to their samples. A short
+// execution has too few samples to tell its segments apart: its cycles are split in proportion to the instructions executed
+void stop_profile_sampling(execution_profile* profile) {
+    struct itimerval timer;
+    memset(&timer, 0, sizeof(timer));
+    setitimer(ITIMER_PROF, &timer, NULL);
+    uint64_t total = READ_CYCLES() - profile->start_cycles;
+    sampled_profile = NULL;
+    profile->total_cycles = total;
+
+    program* p = profile->p;
+    long samples = 0, instructions = 0;
+    for (int i=0; i<=p->length; i++)
+        samples += profile->samples[i];
+    for (int i=0; i<p->length; i++)
+        if (profile->starts[i])
+            instructions += profile->hits[i] * (profile->ends[i] - i + 1);
+    for (int i=0; i<p->length; i++) {
+        if (!profile->starts[i])
+            continue;
+        if (samples >= PROFILE_MIN_SAMPLES)
+            profile->cycles[i] = (uint64_t) ((double) total * profile->samples[i] / samples);
+        else if (instructions > 0)
+            profile->cycles[i] = (uint64_t) ((double) total * profile->hits[i] * (profile->ends[i] - i + 1) / instructions);
+    }
+}
+
+void free_profile(execution_profile* profile) {
+    free(profile->starts);
+    free(profile->ends);
+    free(profile->hits);
+    free(profile->jumps);
+    free(profile->samples);
+    free(profile->cycles);
+    free(profile->code);
+    free(profile->resume);
+    free(profile);
+}
+
+//Return, for each instruction, the first instruction of its segment
+int* get_segment_owners(execution_profile* profile) {
+    program* p = profile->p;
+    int* owners = malloc(p->length * sizeof(int));
+    for (int i=0, owner=0; i<p->length; i++) {
+        if (profile->starts[i])
+            owner = i;
+        owners[i] = owner;
+    }
+    return owners;
+}
+
+//Find the loops and the branches of the program, with their counters, and return how many there are
+int find_constructs(execution_profile* profile, profiled_construct** result) {
+    program* p = profile->p;
+    int* owners = get_segment_owners(profile);
+    uint64_t* cycles_before = calloc(p->length + 1, sizeof(uint64_t));    //Cycles of the segments before each instruction
+    profiled_construct* constructs = malloc((2 * p->length + 1) * sizeof(profiled_construct));
+    int count = 0;
+
+    for (int i=0; i<p->length; i++)
+        cycles_before[i + 1] = cycles_before[i] + (profile->starts[i] ? profile->cycles[i] : 0);
+
+    for (int i=0; i<p->length; i++) {
+        instr* in = &p->code[i];
+        long executions = profile->hits[owners[i]];
+        long taken = profile->jumps[owners[i]];       //A jump is always the last instruction of its segment
+
+        if (in->op == OP_JNZ && in->b <= i)             //Test at the bottom of a loop, jumping back to the body
+            constructs[count++] = (profiled_construct) { "loop", p->lines[i], in->b, i, executions, taken, 0 };
+        else if (in->op == OP_JZ) {                     //Condition of an if, jumping over the body when false
+            constructs[count++] = (profiled_construct) { "if", p->lines[i], i + 1, in->b - 1, executions, taken, 0 };
+            int close = in->b - 1;
+            if (close > i && p->code[close].op == OP_JMP && p->code[close].a > in->b && p->lines[close] == p->lines[i])
+                constructs[count++] = (profiled_construct) { "else", p->lines[i], in->b, p->code[close].a - 1, taken, 0, 0 };
+        }
+    }
+    for (int i=0; i<count; i++)
+        if (constructs[i].last >= constructs[i].first)
+            constructs[i].cycles = cycles_before[constructs[i].last + 1] - cycles_before[constructs[i].first];
+
+    free(owners);
+    free(cycles_before);
+    *result = constructs;
+    return count;
+}
+
+//Load the text of the source, and return its lines (indexed from 1), or NULL if it cannot be read
+char** read_source_lines(const char* path, int* count, char** text) {
+    FILE* in = (path != NULL) ? fopen(path, "rb") : NULL;
+    if (in == NULL)
+        return NULL;
+    fseek(in, 0, SEEK_END);
+    long length = ftell(in);
+    fseek(in, 0, SEEK_SET);
+    *text = malloc(length + 1);
+    length = (long) fread(*text, 1, length, in);
+    (*text)[length] = '\0';
+    fclose(in);
+
+    *count = 1;
+    for (long i=0; i<length; i++)
+        *count += (*text)[i] == '\n';
+    char** lines = malloc((*count + 1) * sizeof(char*));
+    lines[0] = "";
+    lines[1] = *text;
+    for (long i=0, line=1; i<length; i++)
+        if ((*text)[i] == '\n' || (*text)[i] == '\r') {
+            if ((*text)[i] == '\n')
+                lines[++line] = *text + i + 1;
+            (*text)[i] = '\0';
+        }
+    return lines;
+}
+
+int compare_lines_by_cycles(const void* first, const void* second) {
+    const profiled_line* a = first;
+    const profiled_line* b = second;
+    return (a->cycles < b->cycles) - (a->cycles > b->cycles);
+}
+
+int compare_loops_by_iterations(const void* first, const void* second) {
+    const profiled_construct* a = first;
+    const profiled_construct* b = second;
+    return (a->taken < b->taken) - (a->taken > b->taken);
+}
+
+int compare_branches_by_executions(const void* first, const void* second) {
+    const profiled_construct* a = first;
+    const profiled_construct* b = second;
+    return (a->executions < b->executions) - (a->executions > b->executions);
+}
+
+//Order constructs by their first instruction, the outer one first when two start together
+int compare_constructs_by_position(const void* first, const void* second) {
+    const profiled_construct* a = first;
+    const profiled_construct* b = second;
+    if (a->first != b->first)
+        return a->first - b->first;
+    return b->last - a->last;
+}
+
+//Print the hottest lines, the loops that iterate most and the branches executed most, with the share of the cycles of each
+void write_profile_report(execution_profile* profile, const char* source_path, FILE* out) {
+    program* p = profile->p;
+    int max_line = 0;
+    uint64_t total = 0;
+    long instructions = 0;
+
+    for (int i=0; i<p->length; i++)
+        if (p->lines[i] > max_line)
+            max_line = p->lines[i];
+    profiled_line* lines = calloc(max_line + 1, sizeof(profiled_line));
+    for (int line=0; line<=max_line; line++)
+        lines[line].line = line;
+    for (int i=0; i<=p->length; i++) {
+        total += profile->cycles[i];
+        if (i == p->length || !profile->starts[i])
+            continue;
+        profiled_line* line = &lines[p->lines[i]];
+        long executed = profile->hits[i] * (profile->ends[i] - i + 1);
+        line->entries += profile->hits[i];
+        line->instructions += executed;
+        line->cycles += profile->cycles[i];
+        instructions += executed;
+    }
+    double share = (total > 0) ? 100.0 / total : 0;
+
+    int source_count = 0;
+    char* source_text = NULL;
+    char** source = read_source_lines(source_path, &source_count, &source_text);
+
+    long samples = 0;
+    for (int i=0; i<=p->length; i++)
+        samples += profile->samples[i];
+    fprintf(out, "\nProfile: %llu cycles, %ld instructions executed, %ld samples\n", (unsigned long long) profile->total_cycles,
+            instructions, samples);
+    fprintf(out, "\nHottest lines:\n  %6s %14s %6s %14s %12s  %s\n", "Line", "Cycles", "%", "Instructions", "Entries", "Source");
+    qsort(lines, max_line + 1, sizeof(profiled_line), compare_lines_by_cycles);
+    for (int i=0; i <= max_line && i < PROFILE_TOP && lines[i].entries > 0; i++) {
+        const char* text = (source != NULL && lines[i].line < source_count + 1) ? source[lines[i].line] : "";
+        while (*text == ' ' || *text == '\t')
+            text++;
+        fprintf(out, "  %6d %14llu %5.1f%% %14ld %12ld  %.60s\n", lines[i].line, (unsigned long long) lines[i].cycles,
+                lines[i].cycles * share, lines[i].instructions, lines[i].entries, text);
+    }
+
+    profiled_construct* constructs;
+    int count = find_constructs(profile, &constructs);
+    profiled_construct* loops = malloc((count + 1) * sizeof(profiled_construct));
+    profiled_construct* branches = malloc((count + 1) * sizeof(profiled_construct));
+    int loop_count = 0, branch_count = 0;
+    for (int i=0; i<count; i++) {
+        if (strcmp(constructs[i].kind, "loop") == 0)
+            loops[loop_count++] = constructs[i];
+        else if (strcmp(constructs[i].kind, "if") == 0)
+            branches[branch_count++] = constructs[i];
+    }
+
+    fprintf(out, "\nLoops by iterations:\n  %6s %14s %12s %10s %14s %6s\n", "Line", "Iterations", "Entries", "Per entry", "Cycles", "%");
+    qsort(loops, loop_count, sizeof(profiled_construct), compare_loops_by_iterations);
+    for (int i=0; i < loop_count && i < PROFILE_TOP && loops[i].executions > 0; i++) {
+        long entries = loops[i].executions - loops[i].taken;       //Each entry ends with a test that does not jump back
+        fprintf(out, "  %6d %14ld %12ld %10.1f %14llu %5.1f%%\n", loops[i].line, loops[i].taken, entries,
+                (entries > 0) ? (double) loops[i].taken / entries : 0, (unsigned long long) loops[i].cycles, loops[i].cycles * share);
+    }
+
+    fprintf(out, "\nBranches by executions:\n  %6s %14s %14s %14s %7s\n", "Line", "Executions", "True", "False", "True %");
+    qsort(branches, branch_count, sizeof(profiled_construct), compare_branches_by_executions);
+    for (int i=0; i < branch_count && i < PROFILE_TOP && branches[i].executions > 0; i++) {
+        long taken = branches[i].executions - branches[i].taken;   //JZ jumps when the condition is false
+        fprintf(out, "  %6d %14ld %14ld %14ld %6.1f%%\n", branches[i].line, branches[i].executions, taken, branches[i].taken,
+                100.0 * taken / branches[i].executions);
+    }
+
+    free(lines);
+    free(source);
+    free(source_text);
+    free(constructs);
+    free(loops);
+    free(branches);
+}
+
+//Write the collapsed stacks of the execution: for each segment that took some cycles, the loops and branches around it
+// from the outermost, then its line. Return false if the file cannot be written
+bool write_profile_stacks(execution_profile* profile, const char* path) {
+    program* p = profile->p;
+    FILE* out = fopen(path, "w");
+    if (out == NULL)
+        return false;
+
+    profiled_construct* constructs;
+    int count = find_constructs(profile, &constructs);
+    qsort(constructs, count, sizeof(profiled_construct), compare_constructs_by_position);
+    profiled_construct** open = malloc((count + 1) * sizeof(profiled_construct*));    //Constructs around the segment
+    int depth = 0, next = 0;
+
+    for (int s=0; s<p->length; s++) {
+        if (!profile->starts[s])
+            continue;
+        while (depth > 0 && open[depth - 1]->last < s)
+            depth--;
+        for (; next < count && constructs[next].first <= s; next++)
+            if (constructs[next].last >= s)
+                open[depth++] = &constructs[next];
+        if (profile->cycles[s] == 0)
+            continue;
+
+        fprintf(out, "program");
+        for (int d=0; d<depth; d++)
+            fprintf(out, ";%s at line %d", open[d]->kind, open[d]->line);
+        fprintf(out, ";line %d %llu\n", p->lines[s], (unsigned long long) profile->cycles[s]);
+    }
+
+    free(open);
+    free(constructs);
+    fclose(out);
+    return true;
+}
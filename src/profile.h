@@ -0,0 +1,82 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Execution profiler, selected with --profile. The bytecode is cut into segments: runs of instructions on the same source
+   line that are entered only at their first instruction and left only after their last one, so they always execute
+   completely. Segments start at the targets of the jumps, after the jumps, and where the line changes.
+   The virtual machine runs a copy of the code where the first instruction of each segment goes through a counting handler
+   (see vm.c): it notes whether the segment being left was left by a jump, counts the entry in the new one and records it
+   as the running segment. Every other instruction runs at full speed, and the execution without --profile is unchanged.
+   Reading a cycle counter at every entry would cost more than most segments, so time is sampled instead: a SIGPROF timer
+   counts the running segment every PROFILE_INTERVAL microseconds of processor time, and the cycles of the whole execution
+   are split among the segments in proportion to their samples (or to their instructions, if the execution is too short to
+   be sampled). Entries, instructions and jumps are exact counts.
+   Loops and branches are recognized from the shapes of bytecode.c: a loop ends with a backward JNZ (the test is at the
+   bottom), an if starts with a forward JZ, and its else follows the JMP closing the body.
+   The report lists the hottest lines, loops and branches. The stacks of the constructs around each segment are written
+   in the collapsed format read by flame graph tools (one line per segment: frames separated by ';', then the cycles) */
+
+#define PROFILE_TOP 20                  //Rows of each table of the report
+#define PROFILE_INTERVAL 1000           //Microseconds of processor time between two samples (the kernel may round it up to its tick)
+#define PROFILE_MIN_SAMPLES 100         //Samples below which the cycles are split by instructions executed instead
+#define PROFILE_STACKS "profile.folded" //Default destination of the collapsed stacks
+
+//Read a cycle counter, the time stamp counter on x86, otherwise a clock in nanoseconds
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define READ_CYCLES() __builtin_ia32_rdtsc()
+#else
+#define READ_CYCLES() monotonic_nanoseconds()
+#endif
+
+//Struct holding the counters of a profiled execution. Arrays are indexed by instruction, and only the entries of the first
+// instruction of each segment are meaningful. One more entry, past the end of the code, stands for the start of the execution
+typedef struct execution_profile {
+    struct program* p;
+    bool* starts;               //Instructions starting a segment
+    int* ends;                  //Last instruction of each segment
+    long* hits;                 //Times each segment was entered
+    long* jumps;                //Times each segment was left by a jump, instead of going on to the next instruction
+    long* samples;              //Times each segment was running when the timer expired
+    uint64_t* cycles;           //Cycles spent in each segment, estimated from its samples once the execution is over
+    volatile int segment;       //Segment running, read by the timer
+    uint64_t start_cycles;      //Cycle counter when the execution started
+    uint64_t total_cycles;      //Cycles of the whole execution
+    void* code;                 //Copy of the code run by the virtual machine, with the counting handler
+    void* resume;               //Handler (or opcode) of the first instruction of each segment, run after counting
+} execution_profile;
+
+//Struct holding the counters of a source line, summed over its segments
+typedef struct profiled_line {
+    int line;
+    long entries;               //Times one of its segments was entered
+    long instructions;          //Instructions executed
+    uint64_t cycles;
+} profiled_line;
+
+//Struct describing a loop or a branch found in the bytecode, with its counters
+typedef struct profiled_construct {
+    const char* kind;           //"loop", "if" or "else"
+    int line;
+    int first;                  //Instructions in the construct: the body and test of a loop, the body of an if or else
+    int last;
+    long executions;            //Times the jump closing the loop or opening the branch was executed
+    long taken;                 //Times it jumped: iterations of a loop, or conditions found false by an if
+    uint64_t cycles;            //Cycles spent in the construct, nested ones included
+} profiled_construct;
+
+
+//Function signatures, see profile.c for implementation (the counting handler is in vm.c)
+
+uint64_t monotonic_nanoseconds();
+execution_profile* create_profile(struct program* p);
+void start_profile_sampling(execution_profile* profile);
+void stop_profile_sampling(execution_profile* profile);
+void free_profile(execution_profile* profile);
+void write_profile_report(execution_profile* profile, const char* source_path, FILE* out);
+bool write_profile_stacks(execution_profile* profile, const char* path);
+
+#endif
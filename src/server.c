@@ -0,0 +1,322 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <setjmp.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "bytecode.h"
+#include "compilation.h"
+#include "server.h"
+
+/* Compile server on a Unix domain socket, and its client. Check structs declaration in server.h */
+
+static volatile sig_atomic_t server_stopping = 0;      //Set by SIGINT and SIGTERM
+
+
+//Read or write exactly 'length' bytes, going on after partial transfers and interruptions. Return false if the
+// connection is closed or fails first
+bool read_exactly(int fd, void* data, size_t length) {
+    char* position = data;
+    while (length > 0) {
+        ssize_t result = read(fd, position, length);
+        if (result < 0 && errno == EINTR)
+            continue;
+        if (result <= 0)
+            return false;
+        position += result;
+        length -= result;
+    }
+    return true;
+}
+
+bool write_exactly(int fd, const void* data, size_t length) {
+    const char* position = data;
+    while (length > 0) {
+        ssize_t result = write(fd, position, length);
+        if (result < 0 && errno == EINTR)
+            continue;
+        if (result <= 0)
+            return false;
+        position += result;
+        length -= result;
+    }
+    return true;
+}
+
+//Fill a socket address with the path, which must fit in it
+bool make_socket_address(struct sockaddr_un* address, char* socket_path) {
+    memset(address, 0, sizeof(struct sockaddr_un));
+    address->sun_family = AF_UNIX;
+    if (strlen(socket_path) >= sizeof(address->sun_path))
+        return false;
+    strcpy(address->sun_path, socket_path);
+    return true;
+}
+
+
+// Server
+//-------------------------------------------------------------------------------------
+
+//Add a connection accepted by the main thread, and wake up a worker to serve it
+void push_connection(connection_queue* queue, int connection) {
+    pthread_mutex_lock(&queue->lock);
+    if (queue->count == queue->capacity) {
+        int* connections = malloc(2 * queue->capacity * sizeof(int));
+        for (int i = 0; i < queue->count; i++)
+            connections[i] = queue->connections[(queue->first + i) % queue->capacity];
+        free(queue->connections);
+        queue->connections = connections;
+        queue->capacity *= 2;
+        queue->first = 0;
+    }
+    queue->connections[(queue->first + queue->count) % queue->capacity] = connection;
+    queue->count++;
+    pthread_cond_signal(&queue->ready);
+    pthread_mutex_unlock(&queue->lock);
+}
+
+//Wait for the next connection to serve
+int take_connection(connection_queue* queue) {
+    pthread_mutex_lock(&queue->lock);
+    while (queue->count == 0)
+        pthread_cond_wait(&queue->ready, &queue->lock);
+    int connection = queue->connections[queue->first];
+    queue->first = (queue->first + 1) % queue->capacity;
+    queue->count--;
+    pthread_mutex_unlock(&queue->lock);
+    return connection;
+}
+
+//Compile and execute the source held by the worker, printing on 'out' and 'errors' what the command line would print on
+// standard output and standard error. Return the exit status of the command line
+int compile_request(server_worker* worker, compilation* c, int length, FILE* out, FILE* errors) {
+    jmp_buf on_error;
+    program* volatile p = NULL;
+    volatile int status = 1;
+
+    reset_compilation(c);
+    c->on_error = &on_error;
+    c->diagnostics_output = errors;
+
+    if (setjmp(on_error) != 0) {
+        if (c->error_count > 1)
+            fprintf(errors, "\n%d errors\n", c->error_count);
+    } else {
+        open_text_input(worker->source, length);
+        if (yyparse() != 0 || c->error_count > 0)
+            stop_compilation();
+
+        p = build_program();
+        values* registers = run_program(p, NULL);
+        fprintf(out, "\nParsed Successfully! Return ");
+        print_value(out, p->result_type, (p->result_type != UNKNOWN_TYPE) ? &registers[p->result] : NULL);
+        fputc('\n', out);
+        free(registers);
+        status = 0;
+    }
+
+    if (p != NULL)
+        free_program(p);
+    close_input();
+    return status;
+}
+
+//Read a request from the connection, compile it and send back the reply
+void serve_connection(server_worker* worker, compilation* c, int connection) {
+    server_request request;
+    server_reply reply;
+    char* output = NULL;
+    char* errors = NULL;
+    size_t output_length = 0, errors_length = 0;
+
+    if (!read_exactly(connection, &request, sizeof(request)))
+        return;
+    FILE* output_file = open_memstream(&output, &output_length);
+    FILE* errors_file = open_memstream(&errors, &errors_length);
+
+    if (request.length > SERVER_MAX_SOURCE) {
+        fprintf(errors_file, "Source too large: %u bytes, at most %d are accepted\n", request.length, SERVER_MAX_SOURCE);
+        reply.status = 1;
+    } else {
+        if (request.length + 2 > worker->source_capacity) {        //Flex needs two zero bytes after the text
+            worker->source_capacity = 2 * (request.length + 2);
+            worker->source = realloc(worker->source, worker->source_capacity);
+        }
+        if (!read_exactly(connection, worker->source, request.length)) {
+            fclose(output_file);
+            fclose(errors_file);
+            free(output);
+            free(errors);
+            return;
+        }
+        worker->source[request.length] = '\0';
+        worker->source[request.length + 1] = '\0';
+        reply.status = compile_request(worker, c, request.length, output_file, errors_file);
+    }
+
+    fclose(output_file);
+    fclose(errors_file);
+    reply.output_length = output_length;
+    reply.errors_length = errors_length;
+    if (write_exactly(connection, &reply, sizeof(reply)) && write_exactly(connection, output, output_length))
+        write_exactly(connection, errors, errors_length);
+    free(output);
+    free(errors);
+}
+
+//Body of the threads of the server: the compilation and the arena blocks of the thread are kept from one request to the next
+void* server_thread(void* argument) {
+    server_worker* worker = argument;
+    compilation* c = create_compilation();
+
+    while (true) {
+        int connection = take_connection(worker->queue);
+        serve_connection(worker, c, connection);
+        close(connection);
+    }
+    return NULL;
+}
+
+void stop_server(int signal_number) {
+    (void) signal_number;
+    server_stopping = 1;
+}
+
+//Listen on the socket and serve the requests with 'thread_count' threads (0 for one per core), until SIGINT or SIGTERM.
+// A socket file left by a previous server is replaced
+int run_server(char* socket_path, int thread_count) {
+    struct sockaddr_un address;
+    if (!make_socket_address(&address, socket_path)) {
+        printf("Socket path too long: %s\n", socket_path);
+        return 1;
+    }
+
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    unlink(socket_path);
+    if (listener < 0 || bind(listener, (struct sockaddr*) &address, sizeof(address)) != 0 || listen(listener, SERVER_BACKLOG) != 0) {
+        printf("Cannot listen on %s: %s\n", socket_path, strerror(errno));
+        return 1;
+    }
+
+    //Without SA_RESTART, accept is interrupted by the signal and the loop can stop
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = stop_server;
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+    signal(SIGPIPE, SIG_IGN);           //A client gone before its reply must not stop the server
+
+    connection_queue queue;
+    queue.capacity = SERVER_BACKLOG;
+    queue.connections = malloc(queue.capacity * sizeof(int));
+    queue.first = 0;
+    queue.count = 0;
+    pthread_mutex_init(&queue.lock, NULL);
+    pthread_cond_init(&queue.ready, NULL);
+
+    if (thread_count <= 0)
+        thread_count = (int) sysconf(_SC_NPROCESSORS_ONLN);
+    if (thread_count < 1)
+        thread_count = 1;
+    server_worker* workers = calloc(thread_count, sizeof(server_worker));
+    for (int i = 0; i < thread_count; i++) {
+        workers[i].queue = &queue;
+        pthread_create(&workers[i].thread, NULL, server_thread, &workers[i]);
+    }
+
+    printf("Listening on %s with %d threads\n", socket_path, thread_count);
+    fflush(stdout);
+    while (!server_stopping) {
+        int connection = accept(listener, NULL, NULL);
+        if (connection >= 0)
+            push_connection(&queue, connection);
+        else if (errno != EINTR && errno != ECONNABORTED)
+            printf("Cannot accept a connection: %s\n", strerror(errno));
+    }
+
+    //Requests being served are dropped: the threads end with the process
+    close(listener);
+    unlink(socket_path);
+    printf("Server stopped\n");
+    return 0;
+}
+
+
+// Client
+//-------------------------------------------------------------------------------------
+
+//Read a whole file into memory, setting its length. Return NULL if it cannot be read
+char* read_whole_file(FILE* in, size_t* length) {
+    size_t capacity = 1 << 16;
+    char* text = malloc(capacity);
+    size_t count;
+
+    *length = 0;
+    while ((count = fread(text + *length, 1, capacity - *length, in)) > 0) {
+        *length += count;
+        if (*length == capacity) {
+            capacity *= 2;
+            text = realloc(text, capacity);
+        }
+    }
+    if (ferror(in)) {
+        free(text);
+        return NULL;
+    }
+    return text;
+}
+
+//Send the file at 'source_path' (standard input if NULL) to the server, and print its reply as the command line would.
+// Return the exit status of the compilation, or 1 if the server cannot be reached
+int run_client(char* socket_path, char* source_path) {
+    size_t length;
+    char* source;
+    if (source_path != NULL) {
+        printf("Reading file...\n");
+        FILE* in = fopen(source_path, "r");
+        source = (in != NULL) ? read_whole_file(in, &length) : NULL;
+        if (in != NULL)
+            fclose(in);
+    } else
+        source = read_whole_file(stdin, &length);
+    if (source == NULL) {
+        printf("File does not exist!\n");
+        return 1;
+    }
+
+    struct sockaddr_un address;
+    int server = socket(AF_UNIX, SOCK_STREAM, 0);
+    server_request request = { (uint32_t) length };
+    server_reply reply;
+    signal(SIGPIPE, SIG_IGN);           //A server refusing the source replies without reading it: the writes just fail
+    if (server < 0 || !make_socket_address(&address, socket_path) || connect(server, (struct sockaddr*) &address, sizeof(address)) != 0
+        || !write_exactly(server, &request, sizeof(request))) {
+        printf("Cannot reach the server at %s\n", socket_path);
+        free(source);
+        return 1;
+    }
+    write_exactly(server, source, length);      //Its reply is read even if not all of the source was sent
+    if (!read_exactly(server, &reply, sizeof(reply))) {
+        printf("Cannot reach the server at %s\n", socket_path);
+        free(source);
+        return 1;
+    }
+    free(source);
+
+    char* output = malloc(reply.output_length + reply.errors_length + 1);
+    bool received = read_exactly(server, output, reply.output_length + reply.errors_length);
+    close(server);
+    if (!received) {
+        printf("Connection to the server lost\n");
+        free(output);
+        return 1;
+    }
+    fwrite(output, 1, reply.output_length, stdout);
+    fflush(stdout);
+    fwrite(output + reply.output_length, 1, reply.errors_length, stderr);
+    free(output);
+    return reply.status;
+}
@@ -0,0 +1,52 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+#include <stdint.h>
+#include <pthread.h>
+
+/* Compile server, selected with --server, and its client, selected with --connect.
+   The server listens on a Unix domain socket and runs each request on a pool of threads started once: every thread keeps
+   its compilation (see reset_compilation) and its arena blocks from one request to the next, so a request pays neither
+   the process startup nor the creation of the scanner and of the tables. A request is the source of a program; the reply
+   holds what the command line would print on standard output and on standard error, and its exit status */
+
+#define SERVER_BACKLOG 128                  //Connections waiting to be accepted
+#define SERVER_MAX_SOURCE (256 << 20)       //Largest source accepted, in bytes
+
+//Struct sent by the client before the source
+typedef struct server_request {
+    uint32_t length;                //Bytes of the source
+} server_request;
+
+//Struct sent by the server before the two texts of the reply
+typedef struct server_reply {
+    int32_t status;                 //Exit status of the compilation: 0 if the program was executed, 1 after errors
+    uint32_t output_length;         //Bytes of the standard output, followed by the ones of the standard error
+    uint32_t errors_length;
+} server_reply;
+
+//Struct holding the connections accepted and not yet served, in a ring
+typedef struct connection_queue {
+    int* connections;
+    int capacity;
+    int first;
+    int count;
+    pthread_mutex_t lock;
+    pthread_cond_t ready;
+} connection_queue;
+
+//Struct holding the state kept by a thread of the server between its requests
+typedef struct server_worker {
+    connection_queue* queue;
+    pthread_t thread;
+    char* source;                   //Buffer receiving the sources, grown to the largest one seen so far
+    size_t source_capacity;
+} server_worker;
+
+
+//Function signatures, see server.c for implementation
+
+int run_server(char* socket_path, int thread_count);
+int run_client(char* socket_path, char* source_path);
+
+#endif
@@ -0,0 +1,93 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/resource.h>
+#include "stats.h"
+#include "compilation.h"
+
+/* Statistics of the compilation. Check structs declaration in stats.h */
+
+int stats_format = STATS_OFF;   //Set by --stats
+char* stats_path = NULL;        //Set by --stats-file, otherwise the statistics go to standard output
+
+static const char* phase_names[PHASE_COUNT] = { "parse", "lex", "type_check", "symbol_table", "code_generation", "execution", "cache" };
+
+
+//Charge the time elapsed since phase_start to the current phase
+void charge_current_phase() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    context->stats.phase_time[context->current_phase] += (now.tv_sec - context->phase_start.tv_sec) + (now.tv_nsec - context->phase_start.tv_nsec) / 1e9;
+    context->phase_start = now;
+}
+
+int enter_phase(int phase) {
+    int previous = context->current_phase;
+    charge_current_phase();
+    context->current_phase = phase;
+    return previous;
+}
+
+void leave_phase(int previous) {
+    charge_current_phase();
+    context->current_phase = previous;
+}
+
+//Reset every statistic, and start timing from the parse phase
+void start_stats() {
+    memset(&context->stats, 0, sizeof(context->stats));
+    context->current_phase = PHASE_PARSE;
+    clock_gettime(CLOCK_MONOTONIC, &context->phase_start);
+}
+
+//Print the statistics in the format chosen with --stats, to the file given with --stats-file or to 'out'
+void print_stats(FILE* out) {
+    compile_stats* s = &context->stats;
+    charge_current_phase();
+
+    if (stats_path != NULL && (out = fopen(stats_path, "w")) == NULL) {
+        fprintf(stderr, "Cannot write the statistics to %s\n", stats_path);
+        return;
+    }
+
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    double total = 0;
+    for (int i=0; i<PHASE_COUNT; i++)
+        total += s->phase_time[i];
+
+    if (stats_format == STATS_JSON) {
+        fprintf(out, "{\n  \"time\": {");
+        for (int i=0; i<PHASE_COUNT; i++)
+            fprintf(out, "\"%s\": %.6f, ", phase_names[i], s->phase_time[i]);
+        fprintf(out, "\"total\": %.6f},\n", total);
+        fprintf(out, "  \"tokens\": %ld,\n  \"reductions\": %ld,\n", s->tokens, s->reductions);
+        fprintf(out, "  \"lookups\": %ld,\n", s->lookups);
+        fprintf(out, "  \"elements_created\": %ld,\n  \"temps_created\": %ld,\n  \"insertions\": %ld,\n  \"max_block_depth\": %d,\n",
+                s->elements_created, s->temps_created, s->insertions, s->max_block_depth);
+        fprintf(out, "  \"frame_bytes\": %d,\n  \"variable_registers\": %d,\n", s->frame_size, context->slot_count);
+        fprintf(out, "  \"cache_regions\": %ld,\n  \"cache_reused\": %ld,\n", s->cache_regions, s->cache_reused);
+        fprintf(out, "  \"column_rows\": %ld,\n", s->column_rows);
+        fprintf(out, "  \"arena_bytes\": %ld,\n  \"arena_blocks\": %ld,\n  \"peak_rss_kb\": %ld\n}\n",
+                arena_bytes_allocated, arena_blocks_created, usage.ru_maxrss);
+    } else {
+        fprintf(out, "\nStatistics:\n");
+        for (int i=0; i<PHASE_COUNT; i++)
+            fprintf(out, "  %-16s %10.3f ms  %5.1f%%\n", phase_names[i], s->phase_time[i] * 1e3, (total > 0) ? 100 * s->phase_time[i] / total : 0);
+        fprintf(out, "  %-16s %10.3f ms\n", "total", total * 1e3);
+        fprintf(out, "  Tokens %ld, reductions %ld\n", s->tokens, s->reductions);
+        fprintf(out, "  Table lookups %ld\n", s->lookups);
+        fprintf(out, "  Elements created %ld, temporaries created %ld, insertions %ld, max block depth %d\n",
+                s->elements_created, s->temps_created, s->insertions, s->max_block_depth);
+        fprintf(out, "  Frame %d bytes, %d variable registers\n", s->frame_size, context->slot_count);
+        if (s->cache_regions > 0)
+            fprintf(out, "  Regions %ld, %ld reused from the cache\n", s->cache_regions, s->cache_reused);
+        if (s->column_rows > 0)
+            fprintf(out, "  Rows evaluated %ld\n", s->column_rows);
+        fprintf(out, "  Arena %ld bytes in %ld blocks, peak RSS %ld KB\n", arena_bytes_allocated, arena_blocks_created, usage.ru_maxrss);
+    }
+
+    if (stats_path != NULL)
+        fclose(out);
+}
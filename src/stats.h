@@ -0,0 +1,55 @@
+#ifndef STATS_H
+#define STATS_H
+
+/* Statistics of the compilation, printed with --stats.
+   Counters are always updated, since an increment costs nothing compared to the work around it.
+   Times are measured only with --stats: each phase is charged the time spent in it, excluding the phases it calls
+   (for example, a lookup done by a parser rule counts as symbol table time, not as parse time) */
+
+// Phases of the compilation
+#define PHASE_PARSE 0           //Parser, excluding the work done by the other phases in its rules
+#define PHASE_LEX 1
+#define PHASE_TYPE_CHECK 2
+#define PHASE_SYMBOL_TABLE 3
+#define PHASE_CODE_GENERATION 4 //Translation to bytecode and optimization
+#define PHASE_EXECUTION 5       //Virtual machine, native code generation with --emit, or evaluation over --columns
+#define PHASE_CACHE 6           //Splitting the source into regions, reading and writing the cache of --cache-dir
+#define PHASE_COUNT 7
+
+// Output formats of --stats
+#define STATS_OFF 0
+#define STATS_TEXT 1
+#define STATS_JSON 2
+
+//Struct holding every statistic of the compilation, kept in its context (see compilation.h)
+typedef struct compile_stats {
+    double phase_time[PHASE_COUNT];     //Seconds spent in each phase
+    long tokens;
+    long reductions;                    //Rules reduced by the parser
+    long lookups;                       //Calls of lookup and lookup_table
+    long temps_created;                 //Calls of create_temp_element
+    long elements_created;              //Calls of create_element
+    long insertions;                    //Elements added to a symbol table
+    int max_block_depth;                //Deepest nesting of blocks reached
+    int frame_size;                     //Bytes of the frame of the variables, with sibling blocks sharing their part (see add_symbol)
+    long cache_regions;                 //Regions of the source, with --cache-dir
+    long cache_reused;                  //Regions rebuilt from the cache instead of being parsed
+    long column_rows;                   //Rows of the input evaluated, with --columns
+} compile_stats;
+
+extern int stats_format;
+
+//Charge the time elapsed so far to the current phase, and switch to 'phase'.
+// Return the previous phase, to be restored with leave_phase
+#define ENTER_PHASE(phase) int previous_phase = (stats_format != STATS_OFF) ? enter_phase(phase) : 0
+#define LEAVE_PHASE() do { if (stats_format != STATS_OFF) leave_phase(previous_phase); } while (0)
+
+
+//Function signatures, see stats.c for implementation
+
+int enter_phase(int phase);
+void leave_phase(int previous);
+void start_stats();
+void print_stats(FILE* out);
+
+#endif
@@ -3,17 +3,17 @@
 #include <string.h>
 #include <stdbool.h>
 #include "sym_table.h"
+#include "trace.h"
+#include "stats.h"
+#include "compilation.h"
+#include "diagnostics.h"
 
 /* Code for symbol table. Check structs declaration in sym_table.h */
 
 //Functions defined in YACC
-extern void yyerror(char* str, ...);
 extern bool verbose;
 
-//Global Variables
-sym_table *global_table;
-sym_table *current_table;   //Table in which the program is currently. It is initially equal to global_table.
-int temp_count = 1;
+//The state of the symbol tables (current table, temporaries, intern pool) belongs to the compilation, see compilation.h
 
 
 void print_verbose_sym(char* str, ...) {
@@ -29,143 +29,417 @@ void print_verbose_sym(char* str, ...) {
     }
 }
 
-// Functions related to content of variables (struct 'values')
+// Functions related to content of variables (union 'values')
 //-------------------------------------------------------------------------------------
 
-//Create a variable of type 'values'
-values* create_value() {
-    values* value = malloc(sizeof(values));
-    value->i = 0;
-    value->c = '0';
-    value->s = "0";
-    value->f = 0.0;
-    value->b = false;
-
-    return value;
-}
-
-//Print the content of an element to screen, based on its data type
-void print_value(elem* elem) {
-    if (elem==NULL || elem->value == NULL)
-        printf("Value: 0");
+//Print a value of the given data type to the given stream. A NULL value is printed as 0
+void print_value(FILE* out, int type, values* value) {
+    if (value == NULL)
+        fprintf(out, "Value: 0");
     else {
-        switch(elem->type) {
+        switch(type) {
             case INT_TYPE:
-                printf("Value: %d", elem->value->i);
+                fprintf(out, "Value: %d", value->i);
                 break;
             case REAL_TYPE:
-                printf("Value: %f", elem->value->f);
+                fprintf(out, "Value: %f", value->f);
                 break;
             case CHAR_TYPE:
-                printf("Value: %c", elem->value->c);
+                fprintf(out, "Value: %c", value->c);
                 break;
             case STRING_TYPE:
-                printf("Value: %s", elem->value->s);
+                fprintf(out, "Value: %s", value->s);
                 break;
             case BOOL_TYPE:
-                (elem->value->b==true) ? printf("Value: true") : printf("Value: false");
+                (value->b==true) ? fprintf(out, "Value: true") : fprintf(out, "Value: false");
                 break;
             case UNKNOWN_TYPE:
-                printf("Value: 0");
+                fprintf(out, "Value: 0");
                 break;
             default:
-                yyerror("Unrecognized type %d\n", elem->type);
+                fatal_error("Unrecognized type %d\n", type);
                 break;
         }
     }
 }
 
+// Functions related to identifiers (struct 'ident')
+//-------------------------------------------------------------------------------------
+
+//FNV-1a hash of the first 'length' characters of the text
+unsigned int hash_string(char* text, int length) {
+    unsigned int hash = 2166136261u;
+
+    for (int i=0; i<length; i++) {
+        hash ^= (unsigned char) text[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+//Double the size of the intern pool, moving every identifier to its new position
+void grow_intern_pool() {
+    int new_capacity = (context->intern_capacity == 0) ? 256 : context->intern_capacity * 2;
+    ident** new_pool = calloc(new_capacity, sizeof(ident*));
+
+    for (int i=0; i<context->intern_capacity; i++) {
+        if (context->intern_pool[i] != NULL) {
+            int pos = context->intern_pool[i]->hash & (new_capacity - 1);
+            while (new_pool[pos] != NULL)
+                pos = (pos + 1) & (new_capacity - 1);
+            new_pool[pos] = context->intern_pool[i];
+        }
+    }
+
+    free(context->intern_pool);
+    context->intern_pool = new_pool;
+    context->intern_capacity = new_capacity;
+}
+
+//Return the unique identifier corresponding to the given text, creating it the first time it is seen.
+// Called by LEX for every ID token, so that all the occurrences of a name share the same pointer
+ident* intern_identifier(char* text, int length) {
+    if (2 * (context->intern_count + 1) > context->intern_capacity)      //Keep the load factor below 50%
+        grow_intern_pool();
+
+    unsigned int hash = hash_string(text, length);
+    int pos = hash & (context->intern_capacity - 1);
+
+    while (context->intern_pool[pos] != NULL) {
+        ident* id = context->intern_pool[pos];
+        if (id->hash == hash && strncmp(id->name, text, length) == 0 && id->name[length] == '\0')
+            return id;
+        pos = (pos + 1) & (context->intern_capacity - 1);
+    }
+
+    ident* id = arena_alloc(&context->memory, sizeof(ident));
+    id->name = arena_strndup(&context->memory, text, length);
+    id->hash = hash;
+    id->binding = NO_SYMBOL;
+
+    context->intern_pool[pos] = id;
+    context->intern_count++;
+
+    return id;
+}
+
+// Functions related to string values
+//-------------------------------------------------------------------------------------
+
+//Double the size of the string pool, moving every string to its new position
+void grow_string_pool() {
+    int new_capacity = (context->string_capacity == 0) ? 64 : context->string_capacity * 2;
+    char** new_pool = calloc(new_capacity, sizeof(char*));
+
+    for (int i=0; i<context->string_capacity; i++) {
+        if (context->string_pool[i] != NULL) {
+            int pos = STRING_HEADER(context->string_pool[i])->hash & (new_capacity - 1);
+            while (new_pool[pos] != NULL)
+                pos = (pos + 1) & (new_capacity - 1);
+            new_pool[pos] = context->string_pool[i];
+        }
+    }
+
+    free(context->string_pool);
+    context->string_pool = new_pool;
+    context->string_capacity = new_capacity;
+}
+
+//Return the unique string value with the given text, creating it the first time it is seen. The text is preceded by
+// its length and hash (see string_header), so every string value of a compilation is equal to another one only if
+// they are the same pointer
+char* intern_string(const char* text, int length) {
+    if (2 * (context->string_count + 1) > context->string_capacity)      //Keep the load factor below 50%
+        grow_string_pool();
+
+    unsigned int hash = hash_string((char*) text, length);
+    int pos = hash & (context->string_capacity - 1);
+
+    while (context->string_pool[pos] != NULL) {
+        char* string = context->string_pool[pos];
+        if (STRING_HEADER(string)->hash == hash && STRING_LENGTH(string) == (uint32_t) length && memcmp(string, text, length) == 0)
+            return string;
+        pos = (pos + 1) & (context->string_capacity - 1);
+    }
+
+    string_header* header = arena_alloc(&context->memory, sizeof(string_header) + length + 1);
+    header->length = length;
+    header->hash = hash;
+    char* string = (char*) (header + 1);
+    memcpy(string, text, length);
+    string[length] = '\0';            //Still a C string, for printing and for the native code
+
+    context->string_pool[pos] = string;
+    context->string_count++;
+
+    return string;
+}
+
+//Order two string values by their bytes, like strcmp: interned strings are equal only if they are the same pointer,
+// otherwise the common prefix is compared by memcmp (vectorized by the C library) and then the lengths
+int compare_strings(const char* first, const char* second) {
+    if (first == second)
+        return 0;
+    uint32_t first_length = STRING_LENGTH(first), second_length = STRING_LENGTH(second);
+    int order = memcmp(first, second, (first_length < second_length) ? first_length : second_length);
+    return (order != 0) ? order : (first_length > second_length) - (first_length < second_length);
+}
+
+// Functions related to the symbols of the open blocks (struct 'symbol_store')
+//-------------------------------------------------------------------------------------
+
+//Double the capacity of all the arrays of the symbols
+void grow_symbols(symbol_store* symbols) {
+    symbols->capacity = (symbols->capacity == 0) ? 64 : symbols->capacity * 2;
+    symbols->ids = realloc(symbols->ids, symbols->capacity * sizeof(ident*));
+    symbols->types = realloc(symbols->types, symbols->capacity * sizeof(unsigned char));
+    symbols->initialized = realloc(symbols->initialized, symbols->capacity * sizeof(bool));
+    symbols->widths = realloc(symbols->widths, symbols->capacity * sizeof(int));
+    symbols->lines = realloc(symbols->lines, symbols->capacity * sizeof(int));
+    symbols->slots = realloc(symbols->slots, symbols->capacity * sizeof(int));
+    symbols->offsets = realloc(symbols->offsets, symbols->capacity * sizeof(int));
+    symbols->shadowed = realloc(symbols->shadowed, symbols->capacity * sizeof(int));
+    if (symbols->values != NULL)
+        symbols->values = realloc(symbols->values, symbols->capacity * sizeof(values));
+}
+
+//Make room for 'count' more symbols at once, so that a long declaration grows the arrays a single time
+void reserve_symbols(int count) {
+    symbol_store* symbols = &context->symbols;
+    while (symbols->count + count > symbols->capacity)
+        grow_symbols(symbols);
+}
+
+//Give a register to a variable of the given type: the last one freed by a closed block for that type, or a new one.
+// Variables of sibling blocks are never alive together, so they can share registers, and keeping the type means that a
+// register read before being assigned at run time still holds a value of its type (a valid string, for instance)
+int take_slot(int type) {
+    slot_pool* pool = &context->symbols.free_slots[type];
+    if (pool->count > 0)
+        return pool->slots[--pool->count];
+    return context->slot_count++;
+}
+
+//Give back the register of a variable whose block is closed
+void release_slot(int type, int slot) {
+    slot_pool* pool = &context->symbols.free_slots[type];
+    if (pool->count == pool->capacity) {
+        pool->capacity = (pool->capacity == 0) ? 16 : pool->capacity * 2;
+        pool->slots = realloc(pool->slots, pool->capacity * sizeof(int));
+    }
+    pool->slots[pool->count++] = slot;
+}
+
+//Append a symbol with the data of the given element, assign it a register and a position in the frame of the current
+// block, aligned to its type, and make it the binding of its identifier. Return the id of the symbol
+int add_symbol(elem* element) {
+    symbol_store* symbols = &context->symbols;
+    if (symbols->count == symbols->capacity)
+        grow_symbols(symbols);
+
+    int symbol = symbols->count++;
+    symbols->ids[symbol] = element->id;
+    symbols->types[symbol] = element->type;
+    symbols->initialized[symbol] = (element->initializer != NULL);
+    symbols->widths[symbol] = element->width;
+    symbols->lines[symbol] = element->line_number;
+    symbols->slots[symbol] = take_slot(element->type);
+    symbols->shadowed[symbol] = element->id->binding;
+    element->id->binding = symbol;                  //The new symbol hides any outer one with the same name
+
+    sym_table* table = context->current_table;
+    int alignment = get_type_alignment(element->type);
+    symbols->offsets[symbol] = (table->offset + alignment - 1) / alignment * alignment;
+    table->offset = symbols->offsets[symbol] + element->width;
+    if (table->offset > context->stats.frame_size)
+        context->stats.frame_size = table->offset;
+
+    return symbol;
+}
+
+//Release the arrays of the symbols
+void free_symbols(symbol_store* symbols) {
+    free(symbols->ids);
+    free(symbols->types);
+    free(symbols->initialized);
+    free(symbols->widths);
+    free(symbols->lines);
+    free(symbols->slots);
+    free(symbols->offsets);
+    free(symbols->shadowed);
+    for (int type = 0; type < TYPE_COUNT; type++)
+        free(symbols->free_slots[type].slots);
+    free(symbols->values);
+    memset(symbols, 0, sizeof(symbol_store));
+}
+
 // Functions related to symbol table opreations
 //-------------------------------------------------------------------------------------
 
-//Generate a new symvol table
+//Generate a new symvol table, starting after the symbols declared so far
 sym_table *make_table(sym_table* previous) {
     sym_table* new_table = malloc(sizeof(sym_table));
-    new_table->head = NULL;
-    new_table->tail = NULL;
-    new_table->offset = 0;
-    new_table->prev_table = previous;
+    arena_init(&new_table->memory);
+    open_table(new_table, previous);
 
     return new_table;
 }
 
+//Make an empty table for a block starting now, nested in 'previous'. Its variables go after the ones already in the frame
+void open_table(sym_table* table, sym_table* previous) {
+    table->first = context->symbols.count;
+    table->count = 0;
+    table->offset = (previous != NULL) ? previous->offset : 0;
+    table->prev_table = previous;
+}
+
 //Method called at the start of compiler to initialize the global table
 void init_global_table() {
-    global_table = make_table(NULL);
-    current_table = global_table;
+    arena_init(&context->memory);
+    context->scope_capacity = 16;
+    context->scopes = calloc(context->scope_capacity, sizeof(sym_table*));
+    context->global_table = make_table(NULL);
+    context->scopes[0] = context->global_table;
+    context->current_table = context->global_table;
 }
 
 void print_table() {
     if (verbose==true) {
-        elem* iterator;
+        symbol_store* symbols = &context->symbols;
+        sym_table* table = context->current_table;
 
-        printf(" -------------\n  Offset: %d\n", current_table->offset);
-        iterator = current_table->head;
-        while (iterator != NULL) {
-            printf("  Type: %s \t Symbol: %s \t Width: %d \t Line: %d \t ", get_type_string(iterator->type), iterator->name, iterator->width, iterator->line_number);
+        printf(" -------------\n  Offset: %d\n", table->offset);
+        for (int symbol = table->first; symbol < table->first + table->count; symbol++) {
+            printf("  Type: %s \t Symbol: %s \t Width: %d \t Offset: %d \t Line: %d \t ", get_type_string(symbols->types[symbol]), symbols->ids[symbol]->name, symbols->widths[symbol], symbols->offsets[symbol], symbols->lines[symbol]);
 
-            if (iterator->value != NULL)
-                print_value(iterator);
+            if (symbols->values != NULL && symbols->initialized[symbol])    //Content known only after the execution
+                print_value(stdout, symbols->types[symbol], &symbols->values[symbol]);
 
             printf("\n");
-            iterator = iterator->next;
         }
         printf(" -------------\n");
     }
 }
 
 
-//Given an element name, return the corresponding pointer if it exists, NULL otherwise.
-elem *lookup_table(sym_table* table, char* name, bool recurse) {
-    elem *iterator = table->head;
-
-    while (iterator != NULL) {
-        if (strcmp(name,iterator->name) == 0)
-            return iterator;
+//Given an identifier, return the corresponding symbol if it is visible from 'table' (which must be open), NO_SYMBOL
+// otherwise. With recurse false, only the symbols of the block of 'table' are considered. Symbols of the blocks nested
+// in 'table' come after its range, and are skipped by following the bindings they hide
+int lookup_table(sym_table* table, ident* id, bool recurse) {
+    int symbol = id->binding;
+    while (symbol >= table->first + table->count)
+        symbol = context->symbols.shadowed[symbol];
 
-        iterator = iterator->next;
-    }
-
-    if (recurse && table->prev_table != NULL)      //Check also outer blocks
-        return lookup_table(table->prev_table, name, true);
-    else
-        return NULL;
+    context->stats.lookups++;
+    if (!recurse && symbol < table->first)      //Declared in an outer block
+        return NO_SYMBOL;
+    return symbol;
 }
 
-elem *lookup(char* name) {
-    return lookup_table(current_table, name, true);
+//Return the innermost visible symbol with the given identifier. Since identifiers are interned, the symbol is
+// stored in the identifier itself
+int lookup(ident* id) {
+    context->stats.lookups++;
+    return id->binding;
 }
 
-//Entirely delete a table, called when the block is closed
+//Entirely delete a table, at the end of the compilation. Elements live in the arena of the block, so they are released at once
 void remove_table(sym_table* table) {
-    elem* iterator = table->head;
-    elem* temp = table->head;
-
-    while(iterator != NULL) {
-        iterator = iterator->next;
-        temp->next = NULL;
-        free(temp);
-        temp = iterator;
-    }
-    table->head = NULL;
-    table->tail = NULL;
+    arena_release(&table->memory);
+
     table->prev_table = NULL;
     free(table);
 }
 
-//Create a table for the newsted block, and change the current_table variable accordingly
+//Open a table for the newsted block, reusing the one of the last block closed at the same depth, and change the current table accordingly
 void enter_new_block() {
-    current_table = make_table(current_table);
+    ENTER_PHASE(PHASE_SYMBOL_TABLE);
+    int depth = context->block_depth + 1;
+    if (depth == context->scope_capacity) {
+        context->scopes = realloc(context->scopes, 2 * context->scope_capacity * sizeof(sym_table*));
+        memset(context->scopes + context->scope_capacity, 0, context->scope_capacity * sizeof(sym_table*));
+        context->scope_capacity *= 2;
+    }
+
+    if (context->scopes[depth] == NULL)
+        context->scopes[depth] = make_table(context->current_table);
+    else
+        open_table(context->scopes[depth], context->current_table);
+    context->current_table = context->scopes[depth];
+
+    context->block_depth = depth;
+    if (context->block_depth > context->stats.max_block_depth)
+        context->stats.max_block_depth = context->block_depth;
+    TRACE(EVENT_ENTER_BLOCK, context->block_depth);
+    LEAVE_PHASE();
 }
 
-//Move to the outer block (if possible) and remove the inner table
+//Move to the outer block (if possible), making visible again the symbols hidden by the ones of the inner block.
+// The registers of its symbols are given back, and the next block reuses its part of the frame
 void exit_block() {
-    sym_table* old_block = current_table;
+    ENTER_PHASE(PHASE_SYMBOL_TABLE);
+    sym_table* old_block = context->current_table;
+    symbol_store* symbols = &context->symbols;
+
+    if (context->current_table->prev_table != NULL) {
+        context->current_table = context->current_table->prev_table;
+        TRACE(EVENT_EXIT_BLOCK, context->block_depth);
+        context->block_depth--;
+    }
+
+    for (int symbol = symbols->count - 1; symbol >= old_block->first; symbol--) {
+        symbols->ids[symbol]->binding = symbols->shadowed[symbol];
+        if (old_block != context->global_table)
+            release_slot(symbols->types[symbol], symbols->slots[symbol]);
+    }
+    symbols->count = old_block->first;      //Symbols of the closed block are dropped, their ids will be reused
+    arena_release(&old_block->memory);      //The table itself is kept for the next block at the same depth
+    LEAVE_PHASE();
+}
 
-    if (current_table->prev_table != NULL)
-        current_table = current_table->prev_table;
+//Release the memory still in use at the end of the compilation: the blocks left open by an error, the global table,
+// and the memory of the compilation. Arena blocks go back to the free list of the thread, ready for the next compilation
+void free_compilation_memory() {
+    while (context->current_table != context->global_table)
+        exit_block();
+    for (int depth = 0; depth < context->scope_capacity && context->scopes[depth] != NULL; depth++)
+        remove_table(context->scopes[depth]);
+    free(context->scopes);
+    context->scopes = NULL;
+    context->global_table = NULL;
+    context->current_table = NULL;
+    arena_release(&context->memory);
+    free_symbols(&context->symbols);
+
+    free(context->intern_pool);
+    context->intern_pool = NULL;
+    context->intern_capacity = 0;
+    context->intern_count = 0;
+    free(context->string_pool);
+    context->string_pool = NULL;
+    context->string_capacity = 0;
+    context->string_count = 0;
+}
 
-    remove_table(old_block);
+//Empty the tables and the intern pool for the next compilation on the same context, keeping their storage: the arrays
+// of the symbols, the tables of the blocks and the pool stay as large as the previous compilations made them
+void reset_compilation_memory() {
+    while (context->current_table != context->global_table)
+        exit_block();
+    context->symbols.count = 0;
+    for (int type = 0; type < TYPE_COUNT; type++)
+        context->symbols.free_slots[type].count = 0;
+    arena_release(&context->global_table->memory);
+    open_table(context->global_table, NULL);
+
+    arena_release(&context->memory);        //Identifiers and temporaries are taken from it
+    context->free_temps = NULL;
+    if (context->intern_pool != NULL)
+        memset(context->intern_pool, 0, context->intern_capacity * sizeof(ident*));
+    context->intern_count = 0;
+    if (context->string_pool != NULL)
+        memset(context->string_pool, 0, context->string_capacity * sizeof(char*));
+    context->string_count = 0;
 }
 
 // Functions related to variables of type 'elem'
@@ -174,10 +448,11 @@ void exit_block() {
 //Set the type for an element, also adjusting its size
 void set_element_type(elem* el, int type) {
     int width = get_type_size(type);
-    if (type == STRING_TYPE)
-        width = width * strlen(el->value->s);
+    if (type == STRING_TYPE && is_temp_element(el))     //Literal: the content is known
+        width = width * STRING_LENGTH(el->value.s);
+    else if (type == STRING_TYPE)                       //Variable: its content is known only at run time
+        width = sizeof(char*);
 
-    global_table->offset += width;
     el->type = type;
     el->width = width;
 }
@@ -197,8 +472,10 @@ char* get_type_string(int type) {
             return "BOOL";
         case UNKNOWN_TYPE:
             return "UNKNOWN";
+        case ERROR_TYPE:
+            return "ERROR";
         default:
-            yyerror("Unrecognized type %d\n", type);
+            fatal_error("Unrecognized type %d\n", type);
     }
 }
 
@@ -214,55 +491,106 @@ int get_type_size(int type) {
             return sizeof(char);    //Will be enlarged based on the actual content
         case BOOL_TYPE:
             return sizeof(bool);
+        case ERROR_TYPE:
+            return 0;
         default:
-            yyerror("Unrecognized type %d\n", type);
+            fatal_error("Unrecognized type %d\n", type);
     }
 }
 
-//Create a variable of type elem, initially without specifying its type and without adding it to the table
-elem* create_element(char* name, int line_number) {
-    elem* el = malloc(sizeof(elem));  //Allocate dynamic memory
-    el->name = name;
-    el->value = NULL;
+//Return the alignment of a variable of the given type in the frame: the size of the scalars, and of the pointer for strings
+int get_type_alignment(int type) {
+    if (type == STRING_TYPE)
+        return sizeof(char*);
+    if (type == ERROR_TYPE)
+        return 1;
+    return get_type_size(type);
+}
+
+//Create a variable of type elem, initially without specifying its type and without adding it to the table.
+// Memory is taken from the current block, so it is released when the block is closed
+elem* create_element(ident* id, int line_number) {
+    context->stats.elements_created++;
+    elem* el = arena_alloc(&context->current_table->memory, sizeof(elem));
+    el->name = id->name;
+    el->id = id;
+    el->type = UNKNOWN_TYPE;
+    el->width = 0;
+    el->initializer = NULL;
+    memset(&el->value, 0, sizeof(values));
     el->line_number = line_number;
     el->next = NULL;
 
     return el;
 }
 
-//Add a temporary element to the table. The variable name has the form "t0" and is automatically generated
-elem* insert_temp_element(int line_number) {
-    char name[] = "t";
-    char str_count[4];
-    sprintf(str_count, "%d", temp_count);
+//Create a temporary element, holding the value of a literal or of an operation. The name has the form "t1".
+// Temporaries are not added to the table: they are recycled from a pool, so memory stays proportional to the
+// number of temporaries alive at the same time (the depth of the expression being parsed)
+elem* create_temp_element(int line_number) {
+    temp_elem* temp;
+    context->stats.temps_created++;
+
+    if (context->free_temps != NULL) {
+        temp = context->free_temps;
+        context->free_temps = (temp_elem*) temp->element.next;
+    } else {
+        temp = arena_alloc(&context->memory, sizeof(temp_elem));
+    }
+
+    temp->number = context->temp_count++;
+
+    elem* el = &temp->element;
+    el->name = NULL;            //Built by get_element_name, only if needed
+    el->id = NULL;
+    el->type = UNKNOWN_TYPE;
+    el->width = 0;
+    el->line_number = line_number;
+    memset(&el->value, 0, sizeof(values));
+    el->initializer = NULL;
+    el->next = NULL;
 
-    strcat(name, str_count);
-    ++temp_count;
+    return el;
+}
 
-    elem* ret = create_element(strdup(name), line_number);
-    ret->value = create_value();
+//Give a temporary back to the pool, once its value has been used. Other elements are ignored
+void release_temp_element(elem* element) {
+    if (is_temp_element(element)) {
+        element->next = (elem*) context->free_temps;
+        context->free_temps = (temp_elem*) element;
+    }
+}
 
-    insert_element(ret);
+//Check whether an element was created by create_temp_element. Variables always have an identifier
+bool is_temp_element(elem* element) {
+    return element->id == NULL;
+}
 
-    return ret;
+//Return the name of an element, building the "t<number>" name of temporaries the first time it is requested
+char* get_element_name(elem* element) {
+    if (element->name == NULL) {
+        temp_elem* temp = (temp_elem*) element;
+        sprintf(temp->name, "t%d", temp->number);
+        element->name = temp->name;
+    }
+    return element->name;
 }
 
-//Add a variable of type element to the current table
+//Add a variable of type element to the current table, and return the id of its symbol.
 // Also check that no other element with the same identifier have already been defined in the same block
-elem* insert_element(elem* element) {
-    elem* el = lookup_table(current_table, element->name, false);   //With false we don't check in outer blocks
-    if (el != NULL) {
+int insert_element(elem* element) {
+    ENTER_PHASE(PHASE_SYMBOL_TABLE);
+    int symbol = NO_SYMBOL;
+    if (lookup_table(context->current_table, element->id, false) != NO_SYMBOL) {      //With false we don't check in outer blocks
         yyerror("Variable '%s' already declared in the same block!", element->name);
     } else {
-        print_verbose_sym("Symbol '%s' is new, adding to table", element->name);
-
-        if(current_table->head == NULL) {        //The table was empty: initialize head and tail pointers
-            current_table->head = element;
-            current_table->tail = element;
-        } else {                                //Move just the tail pointer
-            current_table->tail->next = element;
-            current_table->tail = current_table->tail->next;
-        }
+        PRINT_VERBOSE_SYM("Symbol '%s' is new, adding to table", element->name);
+
+        symbol = add_symbol(element);
+        context->current_table->count++;
+        TRACE(EVENT_DECLARATION, context->symbols.slots[symbol]);
+        context->stats.insertions++;
     }
-    return el;
+    LEAVE_PHASE();
+    return symbol;
 }
@@ -1,3 +1,11 @@
+#ifndef SYM_TABLE_H
+#define SYM_TABLE_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "arena.h"
+
 // Internal identifiers needed to distinguish different data types
 #define UNKNOWN_TYPE 0  //Default value if not specified otherwise
 #define INT_TYPE 1
@@ -5,55 +13,140 @@
 #define CHAR_TYPE 3
 #define STRING_TYPE 4
 #define BOOL_TYPE 5
+#define ERROR_TYPE 6    //Result of an expression containing errors (see diagnostics.h)
+#define TYPE_COUNT 7    //Number of data types, including UNKNOWN_TYPE
+
+#define NO_SYMBOL -1    //Result of a lookup that found no symbol
 
 
-//Struct describing all possible data values of an element.
-// Just one of them is actually filled, depending on the chosen data type
-typedef struct values {
+//Union describing all possible data values of an element, in 8 bytes.
+// Just one of them is meaningful, depending on the data type stored next to it
+typedef union values {
     int i;
     bool b;
     char c;
     float f;
-    char* s;
+    char* s;        //Interned text, preceded by its string_header
 } values;
 
-//Struct defining the content of each node in the symbol table
+//Struct stored just before the text of every string value, so that the 'char*' of the value also gives its length in O(1).
+// String values are interned (see intern_string): repeated literals share one copy, and equal strings have the same pointer
+typedef struct string_header {
+    uint32_t length;
+    uint32_t hash;
+} string_header;
+
+#define STRING_HEADER(text) ((string_header*) (text) - 1)
+#define STRING_LENGTH(text) (STRING_HEADER(text)->length)
+
+//Struct describing an identifier stored in the intern pool.
+// Each distinct name is stored only once, so identifiers can be compared by pointer instead of using strcmp
+typedef struct ident {
+    char* name;                 //Text of the identifier
+    unsigned int hash;          //Hash of the text, reused when the intern pool grows
+    int binding;                //Innermost visible symbol with this name, or NO_SYMBOL
+} ident;
+
+//Struct defining an element read by LEX: an identifier, or a literal.
+// When a variable is declared, its element is copied into the symbol table (see insert_element)
 typedef struct elem {
     char* name;         //Name of the variable
+    ident* id;          //Interned identifier, used as key in the symbol table
     int type;           //Data type (from the above define list)
     int width;          //Size of the variable (from c sizeof function)
-    int line_number;    //Line where the element was declared
-    values *value;      //Content of the element
-    struct elem *next;  //Pointer to the next value, needed since symbol table is implemented using a linked list
+    int line_number;    //Line where the element was read
+    values value;       //Content of a literal
+    struct node *initializer;   //Expression given in the declaration, until the variable is added to the table
+    struct elem *next;  //Next temporary in the pool of the free ones
 } elem;
 
-//Struct defining the actual symbol table
-// It is a linked list with both head and tail pointers (to improve insertion efficiency)
+//Struct holding the variables of a declaration such as 'int i = 0, j, k = 2;', in order, while its list is parsed.
+// The array lives in the memory of the block and doubles when full, so a list of n variables is built in O(n)
+typedef struct variable_list {
+    elem** items;
+    int count;
+    int capacity;
+} variable_list;
+
+//Struct defining a temporary: the value of a literal or the result of an operation.
+// Temporaries are never added to the symbol table: they are taken from a pool and given back to it
+// as soon as the expression using them has been evaluated
+typedef struct temp_elem {
+    elem element;       //Must be the first field, so that a temp_elem* can be used as an elem*
+    int number;         //Progressive number, used to build the name "t<number>" only when it has to be printed
+    char name[16];
+} temp_elem;
+
+//Struct holding registers that belonged to the variables of closed blocks, ready to be given to new variables
+typedef struct slot_pool {
+    int* slots;
+    int count;
+    int capacity;
+} slot_pool;
+
+//Struct holding the symbols of all the open blocks, as parallel arrays indexed by the symbol id.
+// Blocks are closed in the opposite order in which they are opened, so the symbols of each block take a contiguous
+// range of ids, following the ranges of the outer blocks: closing a block just moves 'count' back.
+// Together with the identifiers they form a single map for all the blocks: each identifier points to its innermost
+// symbol, which remembers the one it hides, so lookups take constant time at any depth.
+// Storage follows the same order: the variables of a block are laid out in the frame after the ones of the blocks around
+// it, so sibling blocks overlap, and the registers of a closed block are given to the next variables of the same type
+typedef struct symbol_store {
+    ident** ids;                    //Interned identifier, used as key in the symbol table
+    unsigned char* types;           //Data type (from the above define list)
+    bool* initialized;              //Whether a value has already been assigned to the variable, in parsing order
+    int* widths;                    //Size of the variable (from c sizeof function)
+    int* lines;                     //Line where the variable was declared
+    int* slots;                     //Register of the virtual machine holding the variable (see bytecode.h)
+    int* offsets;                   //Position of the variable in the frame, in bytes
+    int* shadowed;                  //Symbol hidden by this one (the previous binding of its identifier), visible again when its block is closed
+    values* values;                 //Content of the variables, allocated only to print the final table (see execute_program)
+    int count;
+    int capacity;
+    slot_pool free_slots[TYPE_COUNT];   //Registers of the closed blocks by type, so that a register never changes type
+} symbol_store;
+
+//Struct defining the actual symbol table: the range of the symbols declared in a block.
+// Tables are kept on a stack, one per nesting level, and reused by the next block opened at the same level
 typedef struct sym_table {
-    elem* head;
-    elem* tail;
+    int first;                      //Id of the first symbol of the block
+    int count;                      //Number of symbols in the block
     struct sym_table* prev_table;   //Pointer to the upper symbol table, used in cases of nested blocks
-    int offset;
+    int offset;                     //End of the frame of the block: its variables are laid out after the ones of the outer blocks
+    arena memory;                   //Memory of the elements created in the block, released all together when it is closed
 } sym_table;
 
 
 //Function signatures, see sym_table.c for implementation
 
-values* create_value();
-void print_value(elem* elem);
+void print_value(FILE* out, int type, values* value);
 void set_element_type(elem* el, int type);
 char* get_type_string(int type);
 int get_type_size(int type);
+int get_type_alignment(int type);
+
+ident* intern_identifier(char* text, int length);
+char* intern_string(const char* text, int length);
+int compare_strings(const char* first, const char* second);
 
 sym_table *make_table(sym_table* previous);
+void open_table(sym_table* table, sym_table* previous);
 void init_global_table();
 void print_table();
-elem *lookup_table(sym_table* table, char* name, bool recurse);
-elem *lookup(char* name);
+int lookup_table(sym_table* table, ident* id, bool recurse);
+int lookup(ident* id);
 void remove_table(sym_table* table);
 void enter_new_block();
 void exit_block();
+void free_compilation_memory();
+void reserve_symbols(int count);
+void reset_compilation_memory();
+
+elem* create_element(ident* id, int line_number);
+elem* create_temp_element(int line_number);
+void release_temp_element(elem* element);
+bool is_temp_element(elem* element);
+char* get_element_name(elem* element);
+int insert_element(elem* element);
 
-elem* create_element(char* name, int line_number);
-elem* insert_temp_element(int line_number);
-elem* insert_element(elem* element);
+#endif
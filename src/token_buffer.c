@@ -0,0 +1,135 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <setjmp.h>
+#include "compilation.h"
+#include "token_buffer.h"
+
+/* Parallel lexing into token arrays. Check structs declaration in token_buffer.h */
+
+
+//Split the source in at most 'parts' chunks of similar size, writing where each one starts in 'starts', followed by the
+// length of the source, and return their number. A chunk starts after a newline outside literals and comments, found with
+// the rules of the scanner: a string runs to the next double quote if there is at least a character in between, a char
+// literal is a quote, a character and a quote, and a quote starting neither is an unrecognized character
+int split_source(const char* text, int length, int parts, int* starts) {
+    int count = 1;
+    long next = length / parts;         //Position after which the next chunk starts
+
+    starts[0] = 0;
+    for (int i = 0; i < length && count < parts; i++) {
+        if (text[i] == '"') {
+            const char* end = memchr(text + i + 1, '"', length - i - 1);
+            if (end != NULL && end > text + i + 1)
+                i = (int) (end - text);
+        } else if (text[i] == '\'') {
+            if (i + 2 < length && text[i + 1] != '\'' && text[i + 2] == '\'')
+                i += 2;
+        } else if (text[i] == '/' && i + 1 < length && text[i + 1] == '/') {
+            const char* end = memchr(text + i, '\n', length - i);
+            if (end == NULL)
+                break;
+            i = (int) (end - text) - 1;     //The newline ending the comment is looked at next
+        } else if (text[i] == '\n' && i + 1 >= next) {
+            starts[count++] = i + 1;
+            next = (long) length * count / parts;
+        }
+    }
+
+    starts[count] = length;
+    return count;
+}
+
+//Add a token at the end of the array of a chunk, and return it
+lexed_token* add_chunk_token(token_chunk* chunk) {
+    if (chunk->count == chunk->capacity) {
+        chunk->capacity = (chunk->capacity == 0) ? LEX_CHUNK_TOKENS : 2 * chunk->capacity;
+        chunk->tokens = realloc(chunk->tokens, chunk->capacity * sizeof(lexed_token));
+    }
+    return &chunk->tokens[chunk->count++];
+}
+
+//Body of the threads scanning a chunk. The compilation of the thread only receives what the scanner actions do, and is
+// discarded with the copy of the text
+void* lex_chunk_thread(void* argument) {
+    token_chunk* chunk = argument;
+    jmp_buf on_error;
+    compilation* c = create_compilation();
+    c->diagnostics_output = NULL;
+    c->on_error = &on_error;
+
+    if (setjmp(on_error) == 0) {
+        scan_chunk(chunk);
+        chunk->complete = true;
+    }
+
+    close_input();
+    free_compilation(c);
+    arena_free_all();
+    free(chunk->buffer);
+    chunk->buffer = NULL;
+    return NULL;
+}
+
+//Scan the source with up to 'threads' threads, one per chunk. Chunks are never smaller than LEX_CHUNK_MIN, so a small
+// source gets fewer threads. Return NULL if a chunk could not be scanned
+token_buffer* build_token_buffer(const char* source, int length, int threads) {
+    int parts = length / LEX_CHUNK_MIN;
+    if (parts > threads)
+        parts = threads;
+    if (parts < 1)
+        parts = 1;
+
+    int* starts = malloc((parts + 1) * sizeof(int));
+    token_buffer* b = calloc(1, sizeof(token_buffer));
+    b->source = source;
+    b->chunk_count = split_source(source, length, parts, starts);
+    b->chunks = calloc(b->chunk_count, sizeof(token_chunk));
+    b->first_line = context->number_line;
+
+    for (int i = 0; i < b->chunk_count; i++) {
+        token_chunk* chunk = &b->chunks[i];
+        chunk->offset = starts[i];
+        chunk->length = starts[i + 1] - starts[i];
+        chunk->buffer = malloc(chunk->length + 2);
+        memcpy(chunk->buffer, source + chunk->offset, chunk->length);
+        chunk->buffer[chunk->length] = '\0';
+        chunk->buffer[chunk->length + 1] = '\0';
+        pthread_create(&chunk->thread, NULL, lex_chunk_thread, chunk);
+    }
+
+    bool complete = true;
+    for (int i = 0; i < b->chunk_count; i++) {
+        pthread_join(b->chunks[i].thread, NULL);
+        complete &= b->chunks[i].complete;
+    }
+    free(starts);
+
+    if (!complete) {
+        free_token_buffer(b);
+        return NULL;
+    }
+    return b;
+}
+
+//Scan the input of the compilation ahead with 'threads' threads, if it is held in memory and the tokens are neither printed
+// nor traced: the threads would do it out of order. Return false if the input is left to be scanned while parsing
+bool lex_in_parallel(int threads) {
+    if (threads < 1 || context->mapped_input == NULL || context->input_bytes > INT_MAX || verbose || tracing)
+        return false;
+
+    ENTER_PHASE(PHASE_LEX);
+    context->tokens = build_token_buffer(context->mapped_input, (int) context->input_bytes, threads);
+    LEAVE_PHASE();
+    return context->tokens != NULL;
+}
+
+void free_token_buffer(token_buffer* b) {
+    for (int i = 0; i < b->chunk_count; i++) {
+        free(b->chunks[i].tokens);
+        free(b->chunks[i].buffer);
+    }
+    free(b->chunks);
+    free(b);
+}
@@ -0,0 +1,69 @@
+#ifndef TOKEN_BUFFER_H
+#define TOKEN_BUFFER_H
+
+#include <stdbool.h>
+#include <pthread.h>
+#include "sym_table.h"
+
+/* Parallel lexing, selected with --lex-threads <n>. Before parsing, a source held in memory is split at safe boundaries:
+   newlines outside string and char literals and comments, so that no token is cut. The chunks are scanned at the same time
+   by the flex scanner, each on a thread with a compilation of its own, into compact token arrays, and the parser then pulls
+   the tokens from the arrays instead of calling the scanner (see yylex in flex.lex).
+   What the scanner actions do to the compilation is done again when each token is pulled: literal elements are created,
+   identifiers and strings are interned and unrecognized characters are reported on the parser's thread, in the same order
+   as when lexing and parsing are interleaved. Lines are counted from 1 in each chunk, and moved by the lines of the chunks
+   before it */
+
+#define LEX_CHUNK_MIN (64 << 10)        //Smallest chunk given a thread of its own, in bytes
+#define LEX_CHUNK_TOKENS 4096           //Initial capacity of the token array of a chunk
+
+#define TOKEN_UNRECOGNIZED -1           //Character matched by no rule, reported when pulled
+
+//Struct defining a token scanned ahead, in 16 bytes
+typedef struct lexed_token {
+    int token;
+    int line;                           //Line in the chunk, from 1
+    union {
+        values value;                   //INT, REAL, CHAR and BOOL literals, and the unrecognized character
+        int identifier;                 //Operators and keywords (the 'identifier' of YYSTYPE)
+        struct {
+            int offset;                 //Identifiers and STRING literals, quotes included: position in the source
+            int length;
+        } text;
+    };
+} lexed_token;
+
+//Struct holding a chunk of the source and the tokens scanned from it
+typedef struct token_chunk {
+    char* buffer;                       //Copy of the text followed by the two zero bytes flex needs, freed once scanned
+    int offset;                         //Position of the chunk in the source
+    int length;
+    lexed_token* tokens;
+    int count;
+    int capacity;
+    int lines;                          //Newlines counted by the scanner
+    bool complete;                      //False if the scanner was stopped by an error
+    pthread_t thread;
+} token_chunk;
+
+//Struct holding the tokens of the whole source, pulled in order by the parser
+typedef struct token_buffer {
+    const char* source;
+    token_chunk* chunks;
+    int chunk_count;
+    int current;                        //Chunk being pulled, and next token in it
+    int position;
+    int first_line;                     //Line of the source where the current chunk starts
+} token_buffer;
+
+
+//Function signatures, see token_buffer.c for implementation (scan_chunk and next_buffered_token in flex.lex)
+
+int split_source(const char* text, int length, int parts, int* starts);
+lexed_token* add_chunk_token(token_chunk* chunk);
+token_buffer* build_token_buffer(const char* source, int length, int threads);
+bool lex_in_parallel(int threads);
+void free_token_buffer(token_buffer* b);
+void scan_chunk(token_chunk* chunk);
+
+#endif
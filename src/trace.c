@@ -0,0 +1,104 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "trace.h"
+#include "compilation.h"
+
+/* Binary trace of the compilation. Check structs declaration in trace.h */
+
+bool tracing = false;           //Set by --trace
+char* trace_path = NULL;
+trace_event* trace_ring = NULL;
+long trace_count = 0;           //Events recorded so far: the next one goes at trace_count % TRACE_RING_SIZE
+
+
+//Start recording events, to be written to 'path' by close_trace
+void open_trace(char* path) {
+    trace_ring = malloc(TRACE_RING_SIZE * sizeof(trace_event));
+    trace_path = path;
+    trace_count = 0;
+    tracing = true;
+}
+
+void record_trace_event(int kind, int data) {
+    trace_event* event = &trace_ring[trace_count++ & (TRACE_RING_SIZE - 1)];
+    event->kind = kind;
+    event->line = (context->number_line < (1 << 24)) ? context->number_line : (1 << 24) - 1;
+    event->data = data;
+}
+
+//Write the events in the ring to the trace file, from the oldest to the newest, and stop tracing.
+// Called at the end of the compilation and by yyerror, so that the events leading to an error are kept
+void close_trace() {
+    if (!tracing)
+        return;
+    tracing = false;
+
+    FILE* out = fopen(trace_path, "wb");
+    if (out == NULL) {
+        fprintf(stderr, "Cannot write the trace to %s\n", trace_path);
+        free(trace_ring);
+        return;
+    }
+
+    trace_header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, TRACE_MAGIC, sizeof(header.magic));
+    header.version = 1;
+    header.event_size = sizeof(trace_event);
+    header.total_events = trace_count;
+    header.stored_events = (trace_count < TRACE_RING_SIZE) ? trace_count : TRACE_RING_SIZE;
+    fwrite(&header, sizeof(header), 1, out);
+
+    long first = trace_count - header.stored_events;
+    long split = first & (TRACE_RING_SIZE - 1);         //Position of the oldest event in the ring
+    if (split + header.stored_events <= TRACE_RING_SIZE)
+        fwrite(trace_ring + split, sizeof(trace_event), header.stored_events, out);
+    else {
+        fwrite(trace_ring + split, sizeof(trace_event), TRACE_RING_SIZE - split, out);
+        fwrite(trace_ring, sizeof(trace_event), split, out);
+    }
+
+    fclose(out);
+    free(trace_ring);
+    trace_ring = NULL;
+}
+
+//Print the events stored in a trace file, one per line
+void decode_trace(char* path) {
+    static const char* kind_names[] = { "?", "TOKEN", "COMMENT", "EXPRESSION", "DECLARATION", "STATEMENT", "ENTER_BLOCK", "EXIT_BLOCK" };
+    trace_header header;
+    trace_event event;
+
+    FILE* in = fopen(path, "rb");
+    if (in == NULL || fread(&header, sizeof(header), 1, in) != 1 || memcmp(header.magic, TRACE_MAGIC, sizeof(header.magic)) != 0
+            || header.event_size != sizeof(trace_event)) {
+        printf("%s is not a trace file\n", path);
+        exit(1);
+    }
+
+    printf("Trace %s: %ld events recorded, last %ld kept\n", path, header.total_events, header.stored_events);
+    long sequence = header.total_events - header.stored_events;
+    while (fread(&event, sizeof(event), 1, in) == 1) {
+        const char* kind = (event.kind < sizeof(kind_names) / sizeof(kind_names[0])) ? kind_names[event.kind] : "?";
+        printf("%8ld  Line %4u  %-12s", sequence++, event.line, kind);
+
+        switch(event.kind) {
+            case EVENT_TOKEN:
+            case EVENT_EXPRESSION:
+            case EVENT_STATEMENT:         //The file may be damaged: only valid tokens have a name
+                printf(" %s\n", is_token(event.data) ? get_token_name(event.data) : "?");
+                break;
+            case EVENT_DECLARATION:
+                printf(" r%d\n", event.data);
+                break;
+            case EVENT_ENTER_BLOCK:
+            case EVENT_EXIT_BLOCK:
+                printf(" depth %d\n", event.data);
+                break;
+            default:
+                printf("\n");
+        }
+    }
+    fclose(in);
+}
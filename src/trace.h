@@ -0,0 +1,72 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+/* Trace points of the scanner and the parser.
+   A trace point prints a message in verbose mode (--verbose), and records a compact binary event when tracing (--trace <file>).
+   Events go into a ring buffer, which is written to the file at the end (also on errors) and decoded offline with --decode-trace <file>.
+   Building with -DNO_TRACE compiles every trace point to nothing: the condition becomes the constant false, so the call
+   and its arguments are removed by the compiler. Without the flag, a disabled trace point costs a single test */
+
+// Kinds of events, with the meaning of their data
+#define EVENT_TOKEN 1           //Token code returned by the scanner
+#define EVENT_COMMENT 2         //Nothing
+#define EVENT_EXPRESSION 3      //Operator token of the expression
+#define EVENT_DECLARATION 4     //Register assigned to the variable
+#define EVENT_STATEMENT 5       //Token of the statement (IF, WHILE, FOR, SWITCH, ASSIGN)
+#define EVENT_ENTER_BLOCK 6     //Depth of the new block
+#define EVENT_EXIT_BLOCK 7      //Depth of the closed block
+
+#define TRACE_RING_SIZE (1 << 16)       //Number of events kept: once full, the oldest ones are overwritten
+#define TRACE_MAGIC "FLCTRACE"
+
+//Struct defining one event, 8 bytes
+typedef struct trace_event {
+    unsigned int kind : 8;
+    unsigned int line : 24;     //Source line, saturated at 2^24-1
+    int data;
+} trace_event;
+
+//Header of a trace file, followed by the events from the oldest to the newest
+typedef struct trace_header {
+    char magic[8];
+    int version;
+    int event_size;
+    long total_events;          //Events recorded, including the ones overwritten in the ring
+    long stored_events;
+} trace_header;
+
+extern bool verbose;
+extern bool tracing;
+
+#ifdef NO_TRACE
+#define TRACE_ENABLED false
+#else
+#define TRACE_ENABLED true
+#endif
+
+//Record an event, when tracing
+#define TRACE(kind, data) \
+    do { if (TRACE_ENABLED && tracing) record_trace_event(kind, data); } while (0)
+
+//Print a message of the parser (or of the symbol table) in verbose mode. Arguments are evaluated only when printed
+#define PRINT_VERBOSE(...) \
+    do { if (TRACE_ENABLED && verbose) print_verbose(__VA_ARGS__); } while (0)
+#define PRINT_VERBOSE_SYM(...) \
+    do { if (TRACE_ENABLED && verbose) print_verbose_sym(__VA_ARGS__); } while (0)
+
+//Report a token recognized by the scanner (see print_token in flex.lex)
+#define TRACE_TOKEN(token) \
+    do { if (TRACE_ENABLED && (verbose || tracing)) print_token(token); } while (0)
+
+
+//Function signatures, see trace.c for implementation (print_token in flex.lex, print_verbose in yacc.y)
+
+void open_trace(char* path);
+void record_trace_event(int kind, int data);
+void close_trace();
+void decode_trace(char* path);
+void print_token(int token);
+void print_verbose(char* str, ...);
+void print_verbose_sym(char* str, ...);
+
+#endif
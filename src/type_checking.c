@@ -2,244 +2,122 @@
 #include <stdlib.h>
 #include <string.h>
 #include "y.tab.h"
+#include "trace.h"
+#include "stats.h"
+#include "compilation.h"
+#include "diagnostics.h"
+#include "operators.h"
 
 //Functions defined in YACC
 extern const char* get_token_name(int token);
-extern int number_line;
-extern void print_verbose(char* str, ...);
-extern void yyerror(char* str, ...);
 
 
-//Terminate the program in cases of errors
-void type_error(elem* first, elem* second, int operation_type) {
-    yyerror("Type conflict in expression (%s %s) %s (%s %s)\n", get_type_string(first->type), first->name, get_token_name(operation_type), get_type_string(second->type), second->name);
+//Report a type conflict, and return the type given to the wrong expression
+int type_error(node* first, node* second, int operation_type) {
+    yyerror("Type conflict in expression (%s %s) %s (%s %s)\n", get_type_string(first->type), get_node_name(first), get_token_name(operation_type), get_type_string(second->type), get_node_name(second));
+    return ERROR_TYPE;
 }
 
-//Return the resulting type of the expression, or stops the compiler in cases of type conflicts
-//Note that input and output are integer because this is how YACC internally represents tokens
-int get_exp_result_type(elem* first, elem* second, int operation_type) {
-    int first_type = first->type;
-    int second_type = second->type;
-
-    switch(operation_type) {
-        case ASSIGN:
-            if (first_type == second_type)
-                return 0;
-            else
-                type_error(first, second, operation_type);
-            break;
-
-        case PLUS:
-        case MINUS:
-        case MUL:
-        case DIV:
-            if (first_type==INT_TYPE && second_type==INT_TYPE)
-                return INT_TYPE;
-            else if ((first_type==INT_TYPE && second_type==REAL_TYPE) || (first_type==REAL_TYPE && second_type==INT_TYPE) || (first_type==REAL_TYPE && second_type==REAL_TYPE))
-                return REAL_TYPE;
-            else
-                type_error(first, second, operation_type);
-            break;
-        case MOD:
-            if (first_type==INT_TYPE && second_type==INT_TYPE)
-                return INT_TYPE;
-            else
-                type_error(first, second, operation_type);
-            break;
-
-        case AND:
-        case OR:
-        case NOT:   //NOT has just one operator, but just for simplifying this function was called with first==second
-            if (first_type==BOOL_TYPE && second_type==BOOL_TYPE)
-                return BOOL_TYPE;
-            else
-                type_error(first, second, operation_type);
-            break;
-
-        case GEQ:
-        case SEQ:
-        case GREATER:
-        case SMALLER:
-        case EQUAL:
-            if (
-                (first_type == second_type==INT_TYPE)             ||
-                (first_type==INT_TYPE && second_type==REAL_TYPE)  ||
-                (first_type==REAL_TYPE && second_type==INT_TYPE)  ||
-                (first_type==REAL_TYPE && second_type==REAL_TYPE)
-               )
-                return BOOL_TYPE;
-            else
-                type_error(first, second, operation_type);
-            break;
-        default:
-            yyerror("Operator %s not recognized", get_token_name(operation_type));
+//Return the rule of the operation, or NULL in cases of type conflicts (see operators.h).
+// Operands that already contain errors were reported before, so the conflict is not reported again
+//Note that the operator is an integer because this is how YACC internally represents tokens
+const operator_rule* check_operation(node* first, node* second, int operation_type) {
+    if (first->type == ERROR_TYPE || second->type == ERROR_TYPE)
+        return NULL;
+
+    const operator_rule* rule = get_operator_rule(operation_type, first->type, second->type);
+    if (rule->result_type == UNKNOWN_TYPE) {
+        type_error(first, second, operation_type);
+        return NULL;
     }
+    return rule;
+}
+
+//Return the resulting type of the expression, or ERROR_TYPE in cases of type conflicts. Timed as type checking for --stats
+int get_exp_result_type(node* first, node* second, int operation_type) {
+    ENTER_PHASE(PHASE_TYPE_CHECK);
+    const operator_rule* rule = check_operation(first, second, operation_type);
+    LEAVE_PHASE();
+    return (rule != NULL) ? rule->result_type : ERROR_TYPE;
 }
 
 void check_compatible_type(int type, elem* variable) {
-    if (type != variable->type)
+    ENTER_PHASE(PHASE_TYPE_CHECK);
+    if (type != variable->type && variable->type != ERROR_TYPE)
         yyerror("Type mismatch in initialization of variable %s: expected %s, got %s", variable->name, get_type_string(type), get_type_string(variable->type));
+    LEAVE_PHASE();
 }
 
-void check_statement_type(elem* variable, int statement) {
+void check_statement_type(node* condition, int statement) {
+    ENTER_PHASE(PHASE_TYPE_CHECK);
     switch(statement) {
         case IF:
         case WHILE:
         case FOR:
-            if (variable->type != BOOL_TYPE)
-                yyerror("Wrong type in %s condition for variable %s, expected BOOL", get_token_name(statement), variable->name);
+            if (condition->type != BOOL_TYPE && condition->type != ERROR_TYPE)
+                yyerror("Wrong type in %s condition for variable %s, expected BOOL", get_token_name(statement), get_node_name(condition));
     }
+    LEAVE_PHASE();
 }
 
-//Check that types are compatible, then return a new temporary value holding the expression result
-elem* get_expression_result(elem* first, elem* second, int operation_type) {
-    print_verbose("Evaluating expression %s %s %s", first->name, get_token_name(operation_type), second->name);
-
-    //Create the variable and assign the correct type to it
-    elem* new_elem = insert_temp_element(number_line);
-    new_elem->value = create_value();
-    int type = get_exp_result_type(first, second, operation_type);
-    set_element_type(new_elem, type);
-
-    values* ret_value = new_elem->value;
-    values* first_value = first->value;
-    values* second_value = second->value;
-
-    switch(operation_type) {
-        case PLUS:
-            if (first->type==INT_TYPE && second->type== INT_TYPE)
-                ret_value->i = first_value->i + second_value->i;
-            else if (first->type==INT_TYPE && second->type== REAL_TYPE)
-                ret_value->i = first_value->i + second_value->f;
-            else if(first->type==REAL_TYPE && second->type== INT_TYPE)
-                ret_value->f = first_value->f + second_value->i;
-            else if (first->type==REAL_TYPE && second->type== REAL_TYPE)
-                ret_value->f = first_value->f + second_value->f;
-            break;
-        case MINUS:
-            if (first->type==INT_TYPE && second->type== INT_TYPE)
-                ret_value->i = first_value->i - second_value->i;
-            else if (first->type==INT_TYPE && second->type== REAL_TYPE)
-                ret_value->f = first_value->i - second_value->f;
-            else if(first->type==REAL_TYPE && second->type== INT_TYPE)
-                ret_value->f = first_value->f - second_value->i;
-            else if (first->type==REAL_TYPE && second->type== REAL_TYPE)
-                ret_value->f = first_value->f - second_value->f;
-            break;
-
-        case MUL:
-            if (first->type==INT_TYPE && second->type== INT_TYPE)
-                ret_value->i = first_value->i * second_value->i;
-            else if (first->type==INT_TYPE && second->type== REAL_TYPE)
-                ret_value->f = first_value->i * second_value->f;
-            else if(first->type==REAL_TYPE && second->type== INT_TYPE)
-                ret_value->f = first_value->f * second_value->i;
-            else if (first->type==REAL_TYPE && second->type== REAL_TYPE)
-                ret_value->f = first_value->f * second_value->f;
-            break;
-
-        case DIV:
-            if ((second_value->i == 0) || (second_value->f) == 0)
-                yyerror("Division by 0 between %s and %s", first->name, second->name);
-
-            if (first->type==INT_TYPE && second->type== INT_TYPE)
-                ret_value->i = first_value->i / second_value->i;
-            else if (first->type==INT_TYPE && second->type== REAL_TYPE)
-                ret_value->f = first_value->i / second_value->f;
-            else if(first->type==REAL_TYPE && second->type== INT_TYPE)
-                ret_value->f = first_value->f / second_value->i;
-            else if (first->type==REAL_TYPE && second->type== REAL_TYPE)
-                ret_value->f = first_value->f / second_value->f;
-            break;
-        case MOD:
-            if (second_value->i == 0)
-                yyerror("Division by 0 between %s and %s", first->name, second->name);
-
-            ret_value->i = first_value->i % second_value->i;
-            break;
-
-        case AND:
-            ret_value->b = first_value->b && second_value->b;
-            break;
-        case OR:
-            ret_value->b = first_value->b || second_value->b;
-            break;
-        case NOT:
-            ret_value->b = !first_value->b;
-            break;
-
-        case EQUAL:
-            if (first->type==INT_TYPE && second->type== INT_TYPE)
-                ret_value->b = first_value->i == second_value->i;
-            else if (first->type==INT_TYPE && second->type== REAL_TYPE)
-                ret_value->b = first_value->i == second_value->f;
-            else if(first->type==REAL_TYPE && second->type== INT_TYPE)
-                ret_value->b = first_value->f == second_value->i;
-            else if (first->type==REAL_TYPE && second->type== REAL_TYPE)
-                ret_value->b = first_value->f == second_value->f;
-            else if (first->type==CHAR_TYPE && second->type== CHAR_TYPE)
-                ret_value->b = first_value->c == second_value->c;
-            else if (first->type==STRING_TYPE && second->type== STRING_TYPE)
-                ret_value->b = strcmp(first_value->s, second_value->s) == 0;
-            break;
-        case GEQ:
-            if (first->type==INT_TYPE && second->type== INT_TYPE)
-                ret_value->b = first_value->i >= second_value->i;
-            else if (first->type==INT_TYPE && second->type== REAL_TYPE)
-                ret_value->b = first_value->i >= second_value->f;
-            else if(first->type==REAL_TYPE && second->type== INT_TYPE)
-                ret_value->b = first_value->f >= second_value->i;
-            else if (first->type==REAL_TYPE && second->type== REAL_TYPE)
-                ret_value->b = first_value->f >= second_value->f;
-            else if (first->type==CHAR_TYPE && second->type== CHAR_TYPE)
-                ret_value->b = first_value->c >= second_value->c;
-            else if (first->type==STRING_TYPE && second->type== STRING_TYPE)
-                ret_value->b = strcmp(first_value->s, second_value->s) >= 0;
-            break;
-        case SEQ:
-            if (first->type==INT_TYPE && second->type== INT_TYPE)
-                ret_value->b = first_value->i <= second_value->i;
-            else if (first->type==INT_TYPE && second->type== REAL_TYPE)
-                ret_value->b = first_value->i <= second_value->f;
-            else if(first->type==REAL_TYPE && second->type== INT_TYPE)
-                ret_value->b = first_value->f <= second_value->i;
-            else if (first->type==REAL_TYPE && second->type== REAL_TYPE)
-                ret_value->b = first_value->f <= second_value->f;
-            else if (first->type==CHAR_TYPE && second->type== CHAR_TYPE)
-                ret_value->b = first_value->c <= second_value->c;
-            else if (first->type==STRING_TYPE && second->type== STRING_TYPE)
-                ret_value->b = strcmp(first_value->s, second_value->s) <= 0;
-            break;
-        case SMALLER:
-            if (first->type==INT_TYPE && second->type== INT_TYPE)
-                ret_value->b = first_value->i < second_value->i;
-            else if (first->type==INT_TYPE && second->type== REAL_TYPE)
-                ret_value->b = first_value->i < second_value->f;
-            else if(first->type==REAL_TYPE && second->type== INT_TYPE)
-                ret_value->b = first_value->f < second_value->i;
-            else if (first->type==REAL_TYPE && second->type== REAL_TYPE)
-                ret_value->b = first_value->f < second_value->f;
-            else if (first->type==CHAR_TYPE && second->type== CHAR_TYPE)
-                ret_value->b = first_value->c < second_value->c;
-            else if (first->type==STRING_TYPE && second->type== STRING_TYPE)
-                ret_value->b = strcmp(first_value->s, second_value->s) < 0;
-            break;
-        case GREATER:
-            if (first->type==INT_TYPE && second->type== INT_TYPE)
-                ret_value->b = first_value->i > second_value->i;
-            else if (first->type==INT_TYPE && second->type== REAL_TYPE)
-                ret_value->b = first_value->i > second_value->f;
-            else if(first->type==REAL_TYPE && second->type== INT_TYPE)
-                ret_value->b = first_value->f > second_value->i;
-            else if (first->type==REAL_TYPE && second->type== REAL_TYPE)
-                ret_value->b = first_value->f > second_value->f;
-            else if (first->type==CHAR_TYPE && second->type== CHAR_TYPE)
-                ret_value->b = first_value->c > second_value->c;
-            else if (first->type==STRING_TYPE && second->type== STRING_TYPE)
-                ret_value->b = strcmp(first_value->s, second_value->s) > 0;
-            break;
-        default:
-            yyerror("Operator %s not recognized", get_token_name(operation_type));
+//Check that types are compatible, then return a new node computing the expression result.
+// Nothing is evaluated here: INT operands mixed with REAL ones are wrapped in a conversion node,
+// so that every operation of the tree works on operands of the same type (see bytecode.c)
+node* get_expression_result(node* first, node* second, int operation_type) {
+    TRACE(EVENT_EXPRESSION, operation_type);
+    PRINT_VERBOSE("Evaluating expression %s %s %s", get_node_name(first), get_token_name(operation_type), get_node_name(second));
+
+    ENTER_PHASE(PHASE_TYPE_CHECK);
+    const operator_rule* rule = check_operation(first, second, operation_type);
+    LEAVE_PHASE();
+
+    if (rule == NULL)
+        return make_operation_node(operation_type, ERROR_TYPE, first, (operation_type == NOT) ? NULL : second);
+    if (operation_type == NOT)
+        return make_operation_node(operation_type, rule->result_type, first, NULL);
+
+    if (first->type != rule->operand_type)
+        first = make_conversion_node(first, rule->operand_type);
+    if (second->type != rule->operand_type)
+        second = make_conversion_node(second, rule->operand_type);
+
+    return make_operation_node(operation_type, rule->result_type, first, second);
+}
+
+//Write the value of a case key as it appears in the source
+void format_case_key(char* buffer, size_t size, case_key* k) {
+    switch(k->type) {
+        case REAL_TYPE:   snprintf(buffer, size, "%g", k->real); break;
+        case STRING_TYPE: snprintf(buffer, size, "\"%s\"", k->c->left->value.s); break;
+        case CHAR_TYPE:   snprintf(buffer, size, "'%c'", (char) k->integer); break;
+        case BOOL_TYPE:   snprintf(buffer, size, "%s", k->integer ? "true" : "false"); break;
+        default:          snprintf(buffer, size, "%ld", k->integer); break;
+    }
+}
+
+//Build, for each case of a switch, the comparison between the scrutinee and the case constant, which checks that their
+// types are compatible. Then report the cases selecting a value already selected by an earlier one, found next to it
+// once the keys are sorted
+void check_switch_cases(node* scrutinee, node* cases) {
+    int count = 0;
+    for (node* c = cases->first; c != NULL; c = c->next) {
+        c->condition = get_expression_result(scrutinee, c->left, EQUAL);
+        count++;
+    }
+
+    case_key* keys = arena_alloc(&context->memory, count * sizeof(case_key));
+    count = get_case_keys(cases->first, keys);
+
+    int saved_line = context->number_line;
+    for (int i=1, first=0; i<count; i++) {
+        if (keys[i].integer != keys[first].integer || keys[i].real != keys[first].real) {
+            first = i;
+            continue;
+        }
+        char value[64];
+        format_case_key(value, sizeof(value), &keys[i]);
+        context->number_line = keys[i].c->line_number;
+        yyerror("Duplicate case %s in switch, already selected by the case on line %d", value, keys[first].c->line_number);
     }
-    return new_elem;
+    context->number_line = saved_line;
 }
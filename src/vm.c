@@ -0,0 +1,266 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bytecode.h"
+#include "compilation.h"
+#include "profile.h"
+
+/* Virtual machine executing the bytecode produced by bytecode.c.
+   With GCC and Clang the interpreter is direct-threaded: before running, each instruction is replaced by the address
+   of the code implementing it, and every handler jumps straight to the next one (computed goto).
+   Other compilers use a plain switch inside a loop. Define NO_COMPUTED_GOTO to force the switch.
+   With --profile, a copy of the code is executed where the first instruction of each segment goes through OP_PROFILE
+   (see profile.h) before its own handler */
+
+#if defined(__GNUC__) && !defined(NO_COMPUTED_GOTO)
+#define DIRECT_THREADING
+#endif
+
+//Instruction as seen by the direct-threaded interpreter: the opcode is replaced by the address of its handler
+typedef struct threaded_instr {
+    const void* handler;
+    int a;
+    int b;
+    int c;
+} threaded_instr;
+
+#define OP_PROFILE OPCODE_COUNT     //Pseudo-opcode of the counting handler, only found in the copy of the code run by --profile
+
+
+//Stop the execution, reporting the source line of the failing instruction
+void runtime_error(program* p, int position, char* message) {
+    context->number_line = p->lines[position];
+    fatal_error("%s", message);
+}
+
+//Execute the program, and return the registers as they are at the end of the execution.
+// The caller reads the result from them, and has to free them. With a profile, the execution is counted in it
+values* run_program(program* p, execution_profile* profile) {
+    values* regs = malloc(p->register_count * sizeof(values));
+    clear_registers(p, regs);
+    memcpy(regs + p->constant_base, p->constants, p->constant_count * sizeof(values));
+
+    if (profile != NULL)
+        start_profile_sampling(profile);
+    int failed = interpret(p, regs, profile);
+    if (profile != NULL)
+        stop_profile_sampling(profile);
+    if (failed >= 0) {          //The memory of the execution is released first, since the error may not terminate the process (see batch.c)
+        free(regs);
+        runtime_error(p, failed, "Division by 0");
+        return NULL;
+    }
+    return regs;
+}
+
+//Give the registers below the constants their value at the start of an execution: 0, or the empty string for the
+// STRING variables, so that a string read before being assigned is still a valid one
+void clear_registers(program* p, values* regs) {
+    memset(regs, 0, p->constant_base * sizeof(values));
+    for (int i=0; i<p->string_register_count; i++)
+        regs[p->string_registers[i]].s = p->empty_string;
+}
+
+//Execute the program on the given registers, which already hold the constants. Return -1 at the end of the execution,
+// or the position of the instruction dividing by 0. The program can be executed again on other registers (see columns.c)
+int run_registers(program* p, values* regs) {
+    return interpret(p, regs, NULL);
+}
+
+//Run the interpreter, counting the segments of the code in the profile if it is not NULL
+int interpret(program* p, values* regs, execution_profile* profile) {
+    int segment = p->length;            //Segment being executed, initially the one standing for the start
+
+#ifdef DIRECT_THREADING
+    #define OPCODE_LABEL(name, format) &&label_##name,
+    static const void* labels[] = { OPCODES(OPCODE_LABEL) };
+
+    threaded_instr* code = p->threaded;
+    if (code == NULL) {         //Translated once, on the first execution
+        code = malloc(p->length * sizeof(threaded_instr));
+        for (int i=0; i<p->length; i++) {
+            code[i].handler = labels[p->code[i].op];
+            code[i].a = p->code[i].a;
+            code[i].b = p->code[i].b;
+            code[i].c = p->code[i].c;
+        }
+        p->threaded = code;
+    }
+    if (profile != NULL && profile->code == NULL) {
+        threaded_instr* counted = malloc(p->length * sizeof(threaded_instr));
+        const void** resume = malloc(p->length * sizeof(void*));
+        for (int i=0; i<p->length; i++) {
+            counted[i] = code[i];
+            resume[i] = code[i].handler;
+            if (profile->starts[i])
+                counted[i].handler = &&label_OP_PROFILE;
+        }
+        profile->code = counted;
+        profile->resume = resume;
+    }
+    if (profile != NULL)
+        code = profile->code;
+    threaded_instr* ip = code;
+
+    #define VM_CASE(name)      label_##name:
+    #define VM_NEXT            ip++; goto *ip->handler
+    #define VM_JUMP(target)    ip = code + (target); goto *ip->handler
+    #define VM_RESUME(position)    goto *((const void**) profile->resume)[position]
+
+    goto *ip->handler;
+#else
+    instr* code = p->code;
+    if (profile != NULL && profile->code == NULL) {
+        instr* counted = malloc(p->length * sizeof(instr));
+        int* resume = malloc(p->length * sizeof(int));
+        for (int i=0; i<p->length; i++) {
+            counted[i] = code[i];
+            resume[i] = code[i].op;
+            if (profile->starts[i])
+                counted[i].op = OP_PROFILE;
+        }
+        profile->code = counted;
+        profile->resume = resume;
+    }
+    if (profile != NULL)
+        code = profile->code;
+    instr* ip = code;
+    int op;
+
+    #define VM_CASE(name)      case name:
+    #define VM_NEXT            ip++; continue
+    #define VM_JUMP(target)    ip = code + (target); continue
+    #define VM_RESUME(position)    op = ((int*) profile->resume)[position]; goto dispatch
+
+    for (;;) {
+        op = ip->op;
+    dispatch:
+        switch (op) {
+#endif
+
+    #define R(field)                    regs[ip->field]
+    #define BINARY(name, out, in, operator) VM_CASE(name) R(a).out = R(b).in operator R(c).in; VM_NEXT;
+    #define COMPARE_STRINGS(name, operator) VM_CASE(name) R(a).b = compare_strings(R(b).s, R(c).s) operator 0; VM_NEXT;
+
+    VM_CASE(OP_MOV) R(a) = R(b); VM_NEXT;
+    VM_CASE(OP_I2F) R(a).f = R(b).i; VM_NEXT;
+
+    BINARY(OP_ADD_I, i, i, +)
+    BINARY(OP_SUB_I, i, i, -)
+    BINARY(OP_MUL_I, i, i, *)
+    VM_CASE(OP_DIV_I)               //INT_MIN / -1 overflows, and would trap: the quotient wraps around to INT_MIN
+        if (R(c).i == 0)
+            goto division_by_zero;
+        R(a).i = (R(c).i == -1) ? (int) (0u - (unsigned) R(b).i) : R(b).i / R(c).i;
+        VM_NEXT;
+    VM_CASE(OP_MOD_I)
+        if (R(c).i == 0)
+            goto division_by_zero;
+        R(a).i = (R(c).i == -1) ? 0 : R(b).i % R(c).i;
+        VM_NEXT;
+
+    BINARY(OP_ADD_F, f, f, +)
+    BINARY(OP_SUB_F, f, f, -)
+    BINARY(OP_MUL_F, f, f, *)
+    VM_CASE(OP_DIV_F)
+        if (R(c).f == 0)
+            goto division_by_zero;
+        R(a).f = R(b).f / R(c).f;
+        VM_NEXT;
+
+    BINARY(OP_AND, b, b, &&)
+    BINARY(OP_OR, b, b, ||)
+    VM_CASE(OP_NOT) R(a).b = !R(b).b; VM_NEXT;
+
+    BINARY(OP_EQ_I, b, i, ==)
+    BINARY(OP_GE_I, b, i, >=)
+    BINARY(OP_LE_I, b, i, <=)
+    BINARY(OP_GT_I, b, i, >)
+    BINARY(OP_LT_I, b, i, <)
+
+    BINARY(OP_EQ_F, b, f, ==)
+    BINARY(OP_GE_F, b, f, >=)
+    BINARY(OP_LE_F, b, f, <=)
+    BINARY(OP_GT_F, b, f, >)
+    BINARY(OP_LT_F, b, f, <)
+
+    BINARY(OP_EQ_C, b, c, ==)
+    BINARY(OP_GE_C, b, c, >=)
+    BINARY(OP_LE_C, b, c, <=)
+    BINARY(OP_GT_C, b, c, >)
+    BINARY(OP_LT_C, b, c, <)
+
+    BINARY(OP_EQ_B, b, b, ==)
+    BINARY(OP_GE_B, b, b, >=)
+    BINARY(OP_LE_B, b, b, <=)
+    BINARY(OP_GT_B, b, b, >)
+    BINARY(OP_LT_B, b, b, <)
+
+    VM_CASE(OP_EQ_S) R(a).b = R(b).s == R(c).s; VM_NEXT;     //Strings are interned: equal texts have the same pointer
+    COMPARE_STRINGS(OP_GE_S, >=)
+    COMPARE_STRINGS(OP_LE_S, <=)
+    COMPARE_STRINGS(OP_GT_S, >)
+    COMPARE_STRINGS(OP_LT_S, <)
+
+    VM_CASE(OP_JMP) VM_JUMP(ip->a);
+    VM_CASE(OP_JZ)
+        if (!R(a).b) {
+            VM_JUMP(ip->b);
+        }
+        VM_NEXT;
+    VM_CASE(OP_JNZ)
+        if (R(a).b) {
+            VM_JUMP(ip->b);
+        }
+        VM_NEXT;
+
+    VM_CASE(OP_SWITCH_I)
+        {
+            switch_table* t = &p->tables[ip->b];
+            unsigned index = (unsigned) R(a).i - (unsigned) t->low;      //Values below 'low' wrap around, past the end
+            VM_JUMP((index < (unsigned) t->count) ? t->targets[index] : t->default_target);
+        }
+    VM_CASE(OP_SWITCH_C)
+        {
+            switch_table* t = &p->tables[ip->b];
+            unsigned index = (unsigned) (R(a).c - t->low);
+            VM_JUMP((index < (unsigned) t->count) ? t->targets[index] : t->default_target);
+        }
+    VM_CASE(OP_SWITCH_S)
+        {
+            switch_table* t = &p->tables[ip->b];
+            VM_JUMP(t->targets[STRING_HEADER(R(a).s)->hash & (t->count - 1)]);
+        }
+
+    VM_CASE(OP_RET) goto end;
+
+    //First instruction of a segment: note how the last one was left, and count the entry in this one
+    VM_CASE(OP_PROFILE)
+        {
+            int position = ip - code;
+            profile->jumps[segment] += (position != profile->ends[segment] + 1);
+            profile->hits[position]++;
+            segment = position;
+            profile->segment = position;
+            VM_RESUME(position);
+        }
+
+#ifndef DIRECT_THREADING
+        }
+    }
+#endif
+
+end:
+    return -1;
+
+division_by_zero:
+    return ip - code;
+
+    #undef VM_CASE
+    #undef VM_NEXT
+    #undef VM_JUMP
+    #undef VM_RESUME
+    #undef R
+    #undef BINARY
+    #undef COMPARE_STRINGS
+}
@@ -4,38 +4,104 @@
 #include <stdarg.h>
 #include <stdbool.h>
 #include <string.h>
+#include <time.h>
 #include "globals.h"
+#include "trace.c"
+#include "arena.c"
+#include "stats.c"
 #include "sym_table.c"
+#include "compilation.c"
+#include "diagnostics.c"
+#include "ast.c"
+#include "operators.c"
+#include "keywords.c"
 #include "type_checking.c"
+#include "bytecode.c"
+#include "optimize.c"
+#include "vm.c"
+#include "profile.c"
+#include "native.c"
+#include "columns.c"
+#include "cache.c"
+#include "batch.c"
+#include "generator.c"
+#include "token_buffer.c"
+#include "benchmark.c"
+#include "server.c"
 
 //Useful global variables
 bool verbose = false;
-int variables_list_count = 1;
+int emit_mode = EMIT_NONE;  //Set by --emit: the program is compiled to native code instead of being executed
+char* output_path = NULL;   //Set by --output, otherwise "out.s" or "out.o"
+bool optimize = true;       //Cleared by --no-optimize
+bool optimization_report = false;   //Set by --opt-report
+bool lex_only_mode = false; //Set by --lex-only
+int lex_threads = 0;        //Set by --lex-threads: the input is scanned ahead by this many threads
+char* source_path = NULL;   //Set by --file, otherwise the program is read from standard input
+int source_mode = INPUT_AUTO;   //Set by --input-mode
+char* batch_path = NULL;    //Set by --batch: directory or list of files to compile
+int batch_threads = 0;      //Set by --jobs, 0 for one thread per core (also used by --server)
+char* cache_directory = NULL;   //Set by --cache-dir: regions of the source already compiled are taken from there
+char* columns_path = NULL;  //Set by --columns or --binary-columns: the program is evaluated over the rows of this file
+int columns_format = COLUMNS_CSV;
+int column_mode = COLUMN_MODE_AUTO; //Set by --column-mode
+char* generate_spec = NULL; //Set by --generate: a random program is written instead of compiling one
+char* benchmark_spec = NULL;    //Set by --benchmark: generated programs of growing size are measured
+char* lex_benchmark_spec = NULL;    //Set by --benchmark-lex: a generated program is lexed with more and more threads
+char* server_path = NULL;   //Set by --server: socket on which compile requests are served
+char* connect_path = NULL;  //Set by --connect: socket of the server compiling the program
+bool profiling = false;     //Set by --profile: the execution is counted by line, loop and branch
+char* profile_stacks_path = PROFILE_STACKS;     //Set by --profile-stacks: destination of the collapsed stacks
+
+//Locations are not used by the rules: they are enabled only because their default action runs once per reduction,
+// which makes it the place to count the reductions for --stats
+#define YYLLOC_DEFAULT(Current, Rhs, N) do { context->stats.reductions++; (Current) = YYRHSLOC(Rhs, (N) ? 1 : 0); } while (0)
+
+//The parser stack grows on the heap up to this depth. Each nested block takes a few entries, and generated code may
+// nest thousands of them
+#define YYMAXDEPTH 1000000
+
+//The parser is pure, and passes to the scanner the one of the current compilation
+#define CURRENT_SCANNER (context->scanner)
 
 //Functions prototypes
-void print_verbose(char* str, ...);
-elem **add_variable_to_list(elem** variables, elem* variable, int size);
+variable_list* add_variable_to_list(variable_list* list, elem* variable);
 const char* get_token_name(int token);
-void print_verbose(char* str, ...);
-FILE* get_input_stream(char* path);
+bool is_token(int value);
+void set_input_source(char* path, int mode);
+void lex_only();
+int generate_file(char* spec, char* path);
+void print_usage(char* program_name);
 void resolve_console_params(int argc, char *argv[]);
+void execute_program();
+void evaluate_program_columns();
+void emit_program();
+program* build_program();
 
 %}
 
 /*** Tokens declaration with respective types ***/
 %union {
     int identifier;         //Internal code assigned by YACC to the various tokens, needed for the type_checking file in order to check the kind of operation
-    elem** variables;       //An array of elements (see the struct definition if sym_table.h)
+    variable_list* variables;   //The elements of a declaration (see the struct definition in sym_table.h)
     elem* element;          //One element in the symbol table
+    ident* name;            //Interned name of an identifier (see intern_identifier in sym_table.c)
+    node* tree;             //Node of the abstract syntax tree (see ast.h)
 }
 
 %token <identifier> INT FLOAT CHAR BOOL STRING PLUS MINUS MUL DIV MOD AND OR NOT EQUAL GEQ SEQ GREATER SMALLER ASSIGN IF ELSE WHILE FOR
-%token <element> ID INT_LITERAL REAL_LITERAL BOOL_LITERAL CHAR_LITERAL STRING_LITERAL
+                    //Operators from PLUS to ASSIGN must stay in this order, they index the table of operators.c
+%token <name> ID
+%token <element> INT_LITERAL REAL_LITERAL BOOL_LITERAL CHAR_LITERAL STRING_LITERAL
 %token CASE SWITCH BREAK DEFAULT RETURN LPAREN RPAREN LBRACE RBRACE SEMICOLON COLON COMMA
+%token REGION       //Never in the source: returned first by the scanner when a single region is parsed (see cache.c)
 
 %type <identifier> type
 %type <variables> variables_list
-%type <element> variable initialization assignment expression paren_expression constant return
+%type <element> declared_variable initialization
+%type <name> variable
+%type <tree> expression paren_expression constant return assignment function_body declarations declaration statements statement
+%type <tree> brace_statements if_statement else_if else for_statement while_statement switch_statement cases case default
 
 /** Associativity Rules **/
 %left COMMA
@@ -49,6 +115,11 @@ void resolve_console_params(int argc, char *argv[]);
 %right NOT
 %left LPAREN RPAREN
 
+%locations
+%define api.pure
+%define parse.error verbose
+%lex-param {yyscan_t CURRENT_SCANNER}
+
 /* Specification of the initial rule */
 %start start
 
@@ -59,40 +130,54 @@ void resolve_console_params(int argc, char *argv[]);
 /*** Syntax Rules ***/
 
 start:  function_body return {
-    print_verbose("Final table:");
-    print_table();
-    printf("\nParsed Successfully! Return ");
-    print_value($2);
+    context->program_body = $1;      //The program is executed once parsing is over, see execute_program
+    context->program_result = $2;
     YYACCEPT;     //YYACCEPT terminates YACC successfully
-} ;
-
-return:    RETURN expression SEMICOLON { $$ = $2; }
-         | RETURN SEMICOLON            { $$ = create_element("return", number_line); }
-         | /* empty */                 { yyerror("Missing return statement!");       }
+}
+      | REGION declaration { context->region_tree = $2; }   //Regions of the source parsed one at a time, with --cache-dir
+      | REGION statement   { context->region_tree = $2; }
+      | REGION return      { context->region_tree = $2; }
+      ;
+
+return:    RETURN expression SEMICOLON { $$ = $2;   }
+         | RETURN SEMICOLON            { $$ = NULL; }
+         | RETURN error SEMICOLON      { yyerrok; $$ = make_error_node(); }
+         | /* empty */                 { yyerror("Missing return statement!"); $$ = NULL; }
          ;
-function_body: declarations statements | statements | declarations | /* empty */;
+function_body:   declarations statements { $$ = append_block($1, $2); }
+               | statements              { $$ = $1; }
+               | declarations            { $$ = $1; }
+               | /* empty */             { $$ = make_block_node(); }
+               ;
 
 
 /** Declaration of variables **/
 //-------------------------------------------------------------------------------------------------------------------------------------------------
-declarations: declarations declaration | declaration ;               //Allow one or more declarations
+declarations: declarations declaration { $$ = append_block($1, $2); } | declaration { $$ = $1; } ;   //Allow one or more declarations
 declaration: type variables_list SEMICOLON {
-    elem** variables = $2;
+    variable_list* variables = $2;
+    $$ = make_block_node();                                         //Holds the assignments of the initialized variables
+    reserve_symbols(variables->count);                              //The symbol arrays grow at most once for the whole list
 
-    for(int i=0; i<variables_list_count;i++) {                       //Set the data type for all variables in the list. Methods from sym_table.c are used.
-        elem* variable = variables[i];
+    for(int i=0; i<variables->count;i++) {                          //Set the data type for all variables in the list. Methods from sym_table.c are used.
+        elem* variable = variables->items[i];
         int expected_data_type = $1;
 
-        print_verbose("declaration of %s %s", get_type_string(expected_data_type), variables[i]->name);
+        PRINT_VERBOSE("declaration of %s %s", get_type_string(expected_data_type), variable->name);
 
-        if (variable->type != UNKNOWN_TYPE)                         //Variable was initialized with some value: check that value type
+        if (variable->type != UNKNOWN_TYPE && variable->type != ERROR_TYPE)     //Variable was initialized with some value: check that value type
             check_compatible_type(expected_data_type, variable);    //  is compatible with the declared data type of the variable (see type_checking.c)
-        else                                                        //Variable was not initialized (its type is still unknown): set the type
-            set_element_type(variable, expected_data_type);
-        insert_element(variable);                                   //Add variable to symbol table
+        set_element_type(variable, expected_data_type);             //The variable has the declared type, even after a mismatch or errors in its value
+        int symbol = insert_element(variable);                      //Add variable to symbol table
+        bool bound = symbol != NO_SYMBOL && context->columns != NULL && bind_column(symbol);    //Its value comes from a column (see columns.c)
+
+        if (variable->initializer != NULL && symbol != NO_SYMBOL && !bound)     //The register of the variable is known only now
+            append_statement($$, make_assign_node(symbol, variable->initializer));
     }
 
-} ;
+}
+           | type error SEMICOLON { yyerrok; $$ = make_block_node(); }      //Skip a wrong declaration, and go on parsing from the next one
+           ;
 type:  INT    { $$ = $1; }  //Return the type identifier as defined in LEX
      | CHAR   { $$ = $1; }
      | FLOAT  { $$ = $1; }
@@ -100,30 +185,31 @@ type:  INT    { $$ = $1; }  //Return the type identifier as defined in LEX
      | BOOL   { $$ = $1; }
      ;
 
-variables_list:   variables_list COMMA variable       { $$ = add_variable_to_list($1, $3, ++variables_list_count); }
-                | variables_list COMMA initialization { $$ = add_variable_to_list($1, $3, ++variables_list_count); }
-                | variable                            { $$ = add_variable_to_list(NULL, $1, 1);                    }
-                | initialization                      { $$ = add_variable_to_list(NULL, $1, 1);                    }
+variables_list:   variables_list COMMA declared_variable  { $$ = add_variable_to_list($1, $3);   }
+                | variables_list COMMA initialization     { $$ = add_variable_to_list($1, $3);   }
+                | declared_variable                       { $$ = add_variable_to_list(NULL, $1); }
+                | initialization                          { $$ = add_variable_to_list(NULL, $1); }
                 ;
 
-variable: ID { $$ = $1; } ;     //Pass the elem entry, as created in LEX
+declared_variable: ID { $$ = create_element($1, @1.first_line); } ;    //Create the elem entry of a new variable, on the line of its name
+variable: ID { $$ = $1; } ;     //Pass the interned name, as read by LEX
 
-constant:   MINUS INT_LITERAL  { $2->value->i = -$2->value->i; $$ = $2; }   //Invert the sign
-          | MINUS REAL_LITERAL { $2->value->f = -$2->value->f; $$ = $2; }
-          | INT_LITERAL        { $$ = $1; }    //Pass the elem entry, as created in LEX
-          | REAL_LITERAL       { $$ = $1; }
-          | CHAR_LITERAL       { $$ = $1; }
-          | BOOL_LITERAL       { $$ = $1; }
-          | STRING_LITERAL     { $$ = $1; }
+constant:   MINUS INT_LITERAL  { $2->value.i = -$2->value.i; $$ = make_constant_node($2); }   //Invert the sign
+          | MINUS REAL_LITERAL { $2->value.f = -$2->value.f; $$ = make_constant_node($2); }
+          | INT_LITERAL        { $$ = make_constant_node($1); }    //Turn the elem entry created in LEX into a node
+          | REAL_LITERAL       { $$ = make_constant_node($1); }
+          | CHAR_LITERAL       { $$ = make_constant_node($1); }
+          | BOOL_LITERAL       { $$ = make_constant_node($1); }
+          | STRING_LITERAL     { $$ = make_constant_node($1); }
           ;
 
-initialization: variable ASSIGN expression {
+initialization: declared_variable ASSIGN expression {
     elem* item = $1;
-    elem* exp = $3;
-    item->value = exp->value;               //The check between exp->type and item->type is done in the 'declaration' rule,
-    set_element_type(item, exp->type);      // since in this rule we don't have access to the declared item type
-
-    print_verbose("Initialized %s with value of temp variable %s", item->name, exp->name);
+    node* exp = $3;
+    item->initializer = exp;                    //Turned into an assignment by the 'declaration' rule, once the variable has a register
+    set_element_type(item, exp->type);          //The check between exp->type and item->type is done in the 'declaration' rule,
+                                                // since in this rule we don't have access to the declared item type
+    PRINT_VERBOSE("Initialized %s with value of temp variable %s", item->name, get_node_name(exp));
 
     $$ = item;
 } ;
@@ -147,83 +233,125 @@ expression:   expression PLUS expression    { $$ = get_expression_result($1,$3,$
             | paren_expression              { $$=$1; }
             | constant                      { $$=$1; }
             | variable                      {
-                elem* elem = lookup($1->name);      //Get the variable name as it was set in LEX, then perform a lookup (see sym_table.c)
-                if (elem==NULL)
+                int symbol = lookup($1);          //Look up the name as it was interned by LEX (see sym_table.c)
+                if (symbol == NO_SYMBOL) {
                     yyerror("Variable %s not declared!", $1->name);
-                else if (elem->value == NULL)
-                    yyerror("Variable %s not initialized!", $1->name);
-                $$=elem;
+                    $$ = make_error_node();
+                } else {
+                    if (context->symbols.initialized[symbol] == false)
+                        yyerror("Variable %s not initialized!", $1->name);
+                    $$ = make_variable_node(symbol);
+                }
             }
             ;
 paren_expression: LPAREN expression RPAREN { $$=$2; } ;
 
 
 /** Control-Flow Statements **/
-//   Note that just type checking is preformed, goto and code jumps have not been implemented
+//   Statements are collected in the abstract syntax tree, and executed by the virtual machine once parsing is over (see vm.c)
 //-------------------------------------------------------------------------------------------------------------------------------------------------
-statements:  statements statement | statement ;  //Allow one or more statements
+statements:  statements statement { $$ = append_statement($1, $2); }                 //Allow one or more statements
+           | statement            { $$ = append_statement(make_block_node(), $1); }
+           ;
 statement:   if_statement | for_statement | while_statement | switch_statement
-           | assignment SEMICOLON
+           | assignment SEMICOLON { $$ = $1; }
+           | error SEMICOLON      { yyerrok; $$ = make_error_node(); }     //Skip a wrong statement, and go on parsing from the next one
            ;
 
-brace_statements:   { print_verbose("Creating new symbol table for nested block"); enter_new_block();             }
+brace_statements:   { PRINT_VERBOSE("Creating new symbol table for nested block"); enter_new_block();             }
                   LBRACE function_body RBRACE
-                    { print_verbose("Exiting the nested block, here is its table:"); print_table(); exit_block(); }
+                    { PRINT_VERBOSE("Exiting the nested block, here is its table:"); print_table(); exit_block(); $$ = $3; }
                   ;
 
 
-if_statement:   IF paren_expression brace_statements else_if else { print_verbose("If statement recognized"); check_statement_type($2,$1); }  //See type_checking.c
-              | IF paren_expression brace_statements else         { print_verbose("If statement recognized"); check_statement_type($2,$1); }
+if_statement:   IF paren_expression brace_statements else_if else {     //See type_checking.c
+                    PRINT_VERBOSE("If statement recognized"); TRACE(EVENT_STATEMENT, IF); check_statement_type($2,$1);
+                    $4->last->else_body = $5;                           //The final else belongs to the last else if
+                    $$ = make_if_node($2, $3, $4);
+                }
+              | IF paren_expression brace_statements else { PRINT_VERBOSE("If statement recognized"); TRACE(EVENT_STATEMENT, IF); check_statement_type($2,$1); $$ = make_if_node($2, $3, $4); }
               ;
-else_if:   else_if ELSE IF paren_expression brace_statements  { check_statement_type($4,$2); }
-         | ELSE IF paren_expression brace_statements          { check_statement_type($3,$1); }
+else_if:   else_if ELSE IF paren_expression brace_statements  {         //Each else if is the else branch of the previous one
+               check_statement_type($4,$3);
+               $1->last->else_body = make_if_node($4, $5, NULL);
+               $1->last = $1->last->else_body;
+               $$ = $1;
+           }
+         | ELSE IF paren_expression brace_statements          { check_statement_type($3,$2); $$ = make_if_node($3, $4, NULL); $$->last = $$; }
          ;
-else: ELSE brace_statements | /* empty */ ;
+else: ELSE brace_statements { $$ = $2; } | /* empty */ { $$ = NULL; } ;
+
 
+for_statement: FOR LPAREN declaration expression SEMICOLON assignment RPAREN brace_statements { PRINT_VERBOSE("For statement recognized"); TRACE(EVENT_STATEMENT, FOR); check_statement_type($4,$1); $$ = make_for_node($3, $4, $6, $8); };
 
-for_statement: FOR LPAREN declaration expression SEMICOLON assignment RPAREN brace_statements { print_verbose("For statement recognized"); check_statement_type($4,$1); };
 
+while_statement: WHILE paren_expression brace_statements { PRINT_VERBOSE("While statement recognized"); TRACE(EVENT_STATEMENT, WHILE); check_statement_type($2,$1); $$ = make_while_node($2, $3); } ;
 
-while_statement: WHILE paren_expression brace_statements { print_verbose("While statement recognized");  check_statement_type($2,$1); } ;
 
+switch_statement: SWITCH LPAREN variable RPAREN LBRACE cases default RBRACE {
+    int item = lookup($3);
+    node* scrutinee;
+    if (item == NO_SYMBOL) {
+        yyerror("Variable %s not declared!", $3->name);
+        scrutinee = make_error_node();
+    } else {
+        if (context->symbols.initialized[item] == false)
+            yyerror("Variable %s not initialized!", $3->name);
+        scrutinee = make_variable_node(item);
+    }
 
-switch_statement: SWITCH LPAREN variable RPAREN LBRACE cases default RBRACE ;
-cases: cases case | case { print_verbose("Switch-Case statement recognized"); } ;
-case: CASE constant COLON statements BREAK SEMICOLON ;
-default : DEFAULT COLON statements { print_verbose("Switch-Default statement recognized"); } | /* empty */ ;
+    check_switch_cases(scrutinee, $6);          //See type_checking.c
+    TRACE(EVENT_STATEMENT, SWITCH);
+    $$ = make_switch_node(scrutinee, $6, $7);
+} ;
+cases: cases case { $$ = append_statement($1, $2); } | case { PRINT_VERBOSE("Switch-Case statement recognized"); $$ = append_statement(make_block_node(), $1); } ;
+case: CASE constant COLON statements BREAK SEMICOLON { $$ = make_case_node($2, $4); } ;
+default : DEFAULT COLON statements { PRINT_VERBOSE("Switch-Default statement recognized"); $$ = $3; } | /* empty */ { $$ = NULL; } ;
 
 
 assignment: variable ASSIGN expression {
-    elem* item = lookup($1->name); if (item == NULL) yyerror("Variable %s not declared!", $1->name);
-    elem* exp = $3;
+    int item = lookup($1);
+    node* exp = $3;
 
-    item->value = exp->value;
-    get_exp_result_type(item, exp, $2);    //Check that the expression type is compatible with the variable data type
+    if (item == NO_SYMBOL) {
+        yyerror("Variable %s not declared!", $1->name);
+        $$ = make_error_node();
+    } else {
+        get_exp_result_type(make_variable_node(item), exp, $2);    //Check that the expression type is compatible with the variable data type
+        if (context->cache != NULL && !context->symbols.initialized[item])
+            note_first_assignment(item);                        //Part of the effects of the region (see cache.c)
+        context->symbols.initialized[item] = true;
 
-    print_verbose("Assigned value to %s from temp variable %s", item->name, exp->name);
+        PRINT_VERBOSE("Assigned value to %s from temp variable %s", $1->name, get_node_name(exp));
+        TRACE(EVENT_STATEMENT, ASSIGN);
 
-    $$ = item;
+        $$ = make_assign_node(item, exp);
+    }
 } ;
 
 
 %%
 
 
-//Given a list of variables, append a new variable to it.
-//  This is used for the 'variables_list' rule, for example in the case 'int i=0, j=2;'
-elem **add_variable_to_list(elem** variables, elem* variable, int size) {
-    if (size == 1)
-        variables_list_count = 1;
-
-    elem **new_array;
-    if (variables == NULL)
-        new_array = malloc(sizeof(elem));
-    else
-        new_array = realloc(variables, variables_list_count*sizeof(elem));
-
-    new_array[variables_list_count-1] = variable;
+//Given a list of variables (NULL to start a new one), append a new variable to it.
+//  This is used for the 'variables_list' rule, for example in the case 'int i=0, j=2;'. The list is taken from the memory
+//  of the block, like its elements, so a declaration skipped after a syntax error leaves nothing to free
+variable_list* add_variable_to_list(variable_list* list, elem* variable) {
+    arena* memory = &context->current_table->memory;
+    if (list == NULL) {
+        list = arena_alloc(memory, sizeof(variable_list));
+        list->count = 0;
+        list->capacity = 4;
+        list->items = arena_alloc(memory, list->capacity * sizeof(elem*));
+    } else if (list->count == list->capacity) {             //Double the array: copies add up to less than the final length
+        elem** items = arena_alloc(memory, 2 * list->capacity * sizeof(elem*));
+        memcpy(items, list->items, list->count * sizeof(elem*));
+        list->items = items;
+        list->capacity *= 2;
+    }
 
-    return new_array;
+    list->items[list->count++] = variable;
+    return list;
 }
 
 // Return the textual representation of the token. yytname is automatically generated by YACC in the .h file
@@ -231,6 +359,11 @@ const char* get_token_name(int token) {
     return yytname[token-255];
 }
 
+//Return whether the value is the code of a token declared in this file, which has a name
+bool is_token(int value) {
+    return value > YYUNDEF && value - 255 < YYNTOKENS;
+}
+
 void print_verbose(char* str, ...) {
     if (verbose==true) {
         va_list varlist;
@@ -242,49 +375,376 @@ void print_verbose(char* str, ...) {
     }
 }
 
-//Returns a stream to the file path, if it exists, or to standard input
-FILE* get_input_stream(char* path) {
-    FILE* stream;
+//Translate the parsed program into bytecode, execute it and print the returned value
+void execute_program() {
+    program* p = build_program();
 
-    if(path != NULL) {
-    printf("Reading file...\n");
-    stream = fopen(path, "r");
+    execution_profile* profile = profiling ? create_profile(p) : NULL;
+    ENTER_PHASE(PHASE_EXECUTION);
+    values* registers = run_program(p, profile);
+    LEAVE_PHASE();
 
-        if (stream == NULL) {
-            printf("File does not exist!\n");
+    symbol_store* symbols = &context->symbols;          //Show the content of the variables at the end of the execution
+    symbols->values = realloc(symbols->values, symbols->capacity * sizeof(values));
+    for (int symbol = 0; symbol < symbols->count; symbol++)
+        symbols->values[symbol] = registers[symbols->slots[symbol]];
+    print_verbose("Final table:");
+    print_table();
+
+    printf("\nParsed Successfully! Return ");
+    print_value(stdout, p->result_type, (p->result_type != UNKNOWN_TYPE) ? &registers[p->result] : NULL);
+
+    if (profile != NULL) {
+        write_profile_report(profile, source_path, stdout);
+        if (write_profile_stacks(profile, profile_stacks_path))
+            printf("\nCollapsed stacks written to %s\n", profile_stacks_path);
+        else
+            printf("\nCannot write %s\n", profile_stacks_path);
+        free_profile(profile);
+    }
+    free(registers);
+    free_program(p);
+}
+
+//Translate the parsed program into bytecode, and evaluate it over the rows given with --columns
+void evaluate_program_columns() {
+    program* p = build_program();
+
+    ENTER_PHASE(PHASE_EXECUTION);
+    evaluate_columns(p, column_mode, output_path);
+    LEAVE_PHASE();
+
+    free_program(p);
+}
+
+//Translate the parsed program into bytecode, optimizing it unless --no-optimize was given
+program* build_program() {
+    ENTER_PHASE(PHASE_CODE_GENERATION);
+    int initial_length = 0;
+
+    if (optimization_report) {      //Compile the tree once as it is, just to count its instructions
+        program* unoptimized = compile_program(context->program_body, context->program_result);
+        initial_length = unoptimized->length;
+        free_program(unoptimized);
+    }
+
+    if (optimize)
+        context->program_result = optimize_tree(context->program_body, context->program_result);
+    program* p = compile_program(context->program_body, context->program_result);
+    int removed = optimize ? optimize_program(p) : 0;
+
+    if (optimization_report) {
+        printf("Optimization: %d instructions before, %d after (%d removed, %d by the bytecode pass)\n", initial_length, p->length, initial_length - p->length, removed);
+        printf("              %d expressions folded or simplified, %d dead branches removed\n", context->folded_nodes, context->removed_branches);
+    }
+    print_verbose("Bytecode:");
+    print_program(p);
+
+    LEAVE_PHASE();
+    return p;
+}
+
+//Compile the parsed program to native code, writing assembly or an object file as requested with --emit
+void emit_program() {
+    program* p = build_program();
+    ENTER_PHASE(PHASE_EXECUTION);
+
+    if (emit_mode == EMIT_ASM) {
+        char* path = (output_path != NULL) ? output_path : "out.s";
+        FILE* out = fopen(path, "w");
+        if (out == NULL) {
+            printf("Cannot write %s!\n", path);
             exit(1);
         }
+        emit_assembly(p, out);
+        fclose(out);
+        printf("\nCompiled Successfully! Assembly written to %s\n", path);
     } else {
-        printf("Please type some input, or 'return;' to terminate...\n\n");
-        stream = stdin;
+        char* path = (output_path != NULL) ? output_path : "out.o";
+        if (write_object(p, path) != 0) {
+            printf("Cannot assemble %s!\n", path);
+            exit(1);
+        }
+        printf("\nCompiled Successfully! Object written to %s\n", path);
+    }
+    LEAVE_PHASE();
+
+    free_program(p);
+}
+
+//Prepare the input of the scanner: the file at the given path, if it exists, or standard input
+void set_input_source(char* path, int mode) {
+    if (path != NULL) {
+        printf("Reading file...\n");
+        if (!open_input(path, mode)) {
+            printf("File does not exist!\n");
+            exit(1);
+        }
+    } else
+        open_input(NULL, mode);
+}
+
+//Run the scanner until the end of the input, and return the number of tokens
+long scan_all_tokens() {
+    long tokens = 0;
+    YYSTYPE value;
+    YYLTYPE location;
+    int token;
+
+    while ((token = yylex(&value, &location, context->scanner)) != 0) {
+        tokens++;
+        bool literal = token == INT_LITERAL || token == REAL_LITERAL || token == BOOL_LITERAL || token == CHAR_LITERAL || token == STRING_LITERAL;
+        if (literal)            //Given back to the pool, as the parser does once the literal is used
+            release_temp_element(value.element);
+    }
+    return tokens;
+}
+
+//Run only the scanner over the whole input, and print its throughput and the allocations it makes
+void lex_only() {
+    struct timespec start, end;
+    long tokens;
+    long initial_allocations = arena_allocations;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    lex_in_parallel(lex_threads);
+    tokens = scan_all_tokens();
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    long allocations = arena_allocations - initial_allocations;
+
+    static const char* mode_names[] = { "auto", "stdio", "mmap", "stream" };
+    double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    double megabytes = context->input_bytes / 1e6;
+    printf("Lexed %ld tokens, %ld lines, %.2f MB in %.3f s: %.1f MB/s, %.0f tokens/s (input mode %s)\n",
+           tokens, (long) context->number_line, megabytes, seconds, (seconds > 0) ? megabytes / seconds : 0,
+           (seconds > 0) ? tokens / seconds : 0, mode_names[context->input_mode]);
+    printf("%ld allocations, %.4f per token\n", allocations, (tokens > 0) ? (double) allocations / tokens : 0);
+}
+
+//Write the program generated from the options to a file
+int generate_file(char* spec, char* path) {
+    generator_options options;
+    if (!parse_generator_options(spec, &options)) {
+        printf("Invalid generator options %s\n", spec);
+        return 1;
+    }
+    FILE* out = fopen(path, "w");
+    if (out == NULL) {
+        printf("Cannot write %s\n", path);
+        return 1;
     }
-    return stream;
+    generate_program(&options, out);
+    fclose(out);
+    printf("Program written to %s\n", path);
+    return 0;
 }
 
-//Allowed parameters are:
-//  --file <file>
-//  --verbose
+void print_usage(char* program_name) {
+    printf("Usage: %s [options]\n", program_name);
+    printf("  --file <file>                 read the program from a file instead of standard input\n");
+    printf("  --verbose                     print tokens, rules, tables and bytecode\n");
+    printf("  --input-mode=<mode>           auto (default), stdio, mmap or stream\n");
+    printf("  --lex-only                    run just the scanner, and print its throughput\n");
+    printf("  --lex-threads <n>             scan a file in chunks on n threads before parsing it\n");
+    printf("  --emit=asm | --emit=obj       compile to native code instead of executing the program\n");
+    printf("  --output <file>               destination of --emit, or of the results of --columns\n");
+    printf("  --trace <file>                record the events of the scanner and the parser in a binary trace\n");
+    printf("  --decode-trace <file>         print the events of a trace, and exit\n");
+    printf("  --no-optimize                 skip the optimization passes\n");
+    printf("  --opt-report                  print how many instructions the optimization removes\n");
+    printf("  --stats[=text|json]           print the time of each phase and the counters of the compilation\n");
+    printf("  --stats-file <file>           write the statistics to a file instead of standard output\n");
+    printf("  --batch <directory|list>      compile and execute every .c file of a directory, or every file listed, in parallel\n");
+    printf("  --jobs <n>                    threads used by --batch and --server (default: one per core)\n");
+    printf("  --cache-dir <directory>       reuse the parts of the file compiled by previous runs, kept in the directory\n");
+    printf("  --columns <file>              evaluate the program once per row of a CSV file, whose columns set the global variables\n");
+    printf("  --binary-columns <file>       like --columns, with the values stored in binary (see columns.c)\n");
+    printf("  --column-mode=<mode>          auto (default), vector or row: evaluate a batch of rows per instruction, or one row at a time\n");
+    printf("  --profile                     count the execution by line, loop and branch, and print the hottest ones\n");
+    printf("  --profile-stacks <file>       destination of the collapsed stacks of --profile (default: %s)\n", PROFILE_STACKS);
+    printf("  --server <socket>             serve compile requests on a Unix domain socket, with --jobs threads\n");
+    printf("  --connect <socket>            have the program compiled and executed by the server listening on the socket\n");
+    printf("  --generate <options>          write a random program to --output (default generated.c), see generator.c for the options\n");
+    printf("  --benchmark <options>         measure lexing, parsing and execution of generated programs of growing size\n");
+    printf("  --benchmark-lex <options>     measure the throughput of parallel lexing on a generated program, from 1 to 8 threads\n");
+    printf("  --max-errors <n>              stop the compilation after n errors (default: %d, 0 for no limit)\n", DEFAULT_MAX_ERRORS);
+}
+
+//Allowed parameters are listed in print_usage
 void resolve_console_params(int argc, char *argv[]) {
-    if (argc>=2 && strcmp("--file", argv[1]) == 0)
-        yyin = get_input_stream(argv[2]);   //yyin is an internal yacc variable
-    else
-        yyin = stdin;
+    static const char* input_modes[] = { "--input-mode=auto", "--input-mode=stdio", "--input-mode=mmap", "--input-mode=stream" };
+
+    for (int i=1; i<argc; i++) {
+        int known_mode = -1;
+        for (int m=0; m<4; m++)
+            if (strcmp(input_modes[m], argv[i]) == 0)
+                known_mode = m;
+
+        if (strcmp("--file", argv[i]) == 0 && i+1 < argc)
+            source_path = argv[++i];
+        else if (strcmp("--verbose", argv[i]) == 0)
+            verbose = true;
+        else if (known_mode >= 0)
+            source_mode = known_mode;
+        else if (strcmp("--lex-only", argv[i]) == 0)
+            lex_only_mode = true;
+        else if (strcmp("--emit=asm", argv[i]) == 0)
+            emit_mode = EMIT_ASM;
+        else if (strcmp("--emit=obj", argv[i]) == 0)
+            emit_mode = EMIT_OBJECT;
+        else if (strcmp("--output", argv[i]) == 0 && i+1 < argc)
+            output_path = argv[++i];
+        else if (strcmp("--trace", argv[i]) == 0 && i+1 < argc)
+            open_trace(argv[++i]);
+        else if (strcmp("--decode-trace", argv[i]) == 0 && i+1 < argc) {
+            decode_trace(argv[++i]);
+            exit(0);
+        }
+        else if (strcmp("--no-optimize", argv[i]) == 0)
+            optimize = false;
+        else if (strcmp("--opt-report", argv[i]) == 0)
+            optimization_report = true;
+        else if (strcmp("--stats", argv[i]) == 0 || strcmp("--stats=text", argv[i]) == 0)
+            stats_format = STATS_TEXT;
+        else if (strcmp("--stats=json", argv[i]) == 0)
+            stats_format = STATS_JSON;
+        else if (strcmp("--stats-file", argv[i]) == 0 && i+1 < argc)
+            stats_path = argv[++i];
+        else if (strcmp("--batch", argv[i]) == 0 && i+1 < argc)
+            batch_path = argv[++i];
+        else if (strcmp("--profile", argv[i]) == 0)
+            profiling = true;
+        else if (strcmp("--profile-stacks", argv[i]) == 0 && i+1 < argc) {
+            profiling = true;
+            profile_stacks_path = argv[++i];
+        }
+        else if (strcmp("--lex-threads", argv[i]) == 0 && i+1 < argc)
+            lex_threads = atoi(argv[++i]);
+        else if (strcmp("--jobs", argv[i]) == 0 && i+1 < argc)
+            batch_threads = atoi(argv[++i]);
+        else if (strcmp("--cache-dir", argv[i]) == 0 && i+1 < argc)
+            cache_directory = argv[++i];
+        else if (strcmp("--columns", argv[i]) == 0 && i+1 < argc) {
+            columns_path = argv[++i];
+            columns_format = COLUMNS_CSV;
+        }
+        else if (strcmp("--binary-columns", argv[i]) == 0 && i+1 < argc) {
+            columns_path = argv[++i];
+            columns_format = COLUMNS_BINARY;
+        }
+        else if (strcmp("--column-mode=auto", argv[i]) == 0)
+            column_mode = COLUMN_MODE_AUTO;
+        else if (strcmp("--column-mode=vector", argv[i]) == 0)
+            column_mode = COLUMN_MODE_VECTOR;
+        else if (strcmp("--column-mode=row", argv[i]) == 0)
+            column_mode = COLUMN_MODE_ROW;
+        else if (strcmp("--server", argv[i]) == 0 && i+1 < argc)
+            server_path = argv[++i];
+        else if (strcmp("--connect", argv[i]) == 0 && i+1 < argc)
+            connect_path = argv[++i];
+        else if (strcmp("--generate", argv[i]) == 0 && i+1 < argc)
+            generate_spec = argv[++i];
+        else if (strcmp("--benchmark", argv[i]) == 0 && i+1 < argc)
+            benchmark_spec = argv[++i];
+        else if (strcmp("--benchmark-lex", argv[i]) == 0 && i+1 < argc)
+            lex_benchmark_spec = argv[++i];
+        else if (strcmp("--max-errors", argv[i]) == 0 && i+1 < argc)
+            max_errors = atoi(argv[++i]);
+        else {
+            printf("Unknown parameter %s\n", argv[i]);
+            print_usage(argv[0]);
+            exit(1);
+        }
+    }
 
-    if ((argc>=2 && strcmp("--verbose", argv[1]) == 0) || (argc>=4 && strcmp("--verbose", argv[3]) == 0))
-        verbose = true;
+    //Compilations of a batch run at the same time, so they cannot print nor record anything while running
+    if (batch_path != NULL && (verbose || tracing || lex_only_mode || emit_mode != EMIT_NONE || optimization_report || stats_format != STATS_OFF)) {
+        printf("--batch cannot be combined with --verbose, --trace, --lex-only, --emit, --opt-report or --stats\n");
+        exit(1);
+    }
+    if (cache_directory != NULL && (source_path == NULL || batch_path != NULL || lex_only_mode)) {
+        printf("--cache-dir needs --file, and cannot be combined with --batch or --lex-only\n");
+        exit(1);
+    }
+    //Requests are compiled by the threads of the server, with the options the server was given
+    if ((server_path != NULL || connect_path != NULL) && (verbose || tracing || lex_only_mode || emit_mode != EMIT_NONE || optimization_report
+                                                          || stats_format != STATS_OFF || batch_path != NULL || cache_directory != NULL || columns_path != NULL)) {
+        printf("--server and --connect cannot be combined with --verbose, --trace, --lex-only, --emit, --opt-report, --stats, --batch, --cache-dir or --columns\n");
+        exit(1);
+    }
+    //Only the execution of a single program by the virtual machine is profiled
+    if (profiling && (batch_path != NULL || server_path != NULL || connect_path != NULL || lex_only_mode || emit_mode != EMIT_NONE || columns_path != NULL)) {
+        printf("--profile cannot be combined with --batch, --server, --connect, --lex-only, --emit or --columns\n");
+        exit(1);
+    }
+    //The variables are bound to the columns while parsing, which regions taken from the cache skip
+    if (columns_path != NULL && (batch_path != NULL || cache_directory != NULL || lex_only_mode || emit_mode != EMIT_NONE)) {
+        printf("--columns cannot be combined with --batch, --cache-dir, --lex-only or --emit\n");
+        exit(1);
+    }
 }
 
 int main(int argc, char *argv[]) {
     printf("-----  Formal Languages and Compilers  Project  -----\n       Alessandro Gottardi and Lucia Maninetti\n\n");
 
-    init_global_table();
-
     resolve_console_params(argc, argv);
+    if (generate_spec != NULL)
+        return generate_file(generate_spec, (output_path != NULL) ? output_path : "generated.c");
+    if (benchmark_spec != NULL)
+        return run_benchmark(benchmark_spec, source_mode);
+    if (lex_benchmark_spec != NULL)
+        return run_lex_benchmark(lex_benchmark_spec);
+    if (server_path != NULL)
+        return run_server(server_path, batch_threads);
+    if (connect_path != NULL)
+        return run_client(connect_path, source_path);
+    if (batch_path != NULL)
+        return run_batch(batch_path, batch_threads, source_mode);
+
+    compilation* c = create_compilation();
+
+    if (lex_only_mode) {
+        set_input_source(source_path, source_mode);
+        lex_only();
+        close_input();
+        close_trace();
+        if (stats_format != STATS_OFF)
+            print_stats(stdout);
+        free_compilation(c);
+        arena_free_all();
+        return 0;
+    }
 
-    int parse_ret = yyparse();
-    fclose(yyin);
+    if (columns_path != NULL && !open_columns(columns_path, columns_format)) {
+        printf("Cannot read the columns %s!\n", columns_path);
+        exit(1);
+    }
 
-    exit_block();
+    int parse_ret;
+    if (cache_directory != NULL)
+        parse_ret = parse_with_cache(source_path, source_mode, cache_directory);
+    else {
+        set_input_source(source_path, source_mode);
+        lex_in_parallel(lex_threads);
+        parse_ret = yyparse();
+    }
+    close_input();
+    if (context->error_count > 0)       //Errors were reported while parsing: the program is not translated
+        stop_compilation();
+    close_trace();
+
+    if (parse_ret == 0 && emit_mode != EMIT_NONE)
+        emit_program();
+    else if (parse_ret == 0 && columns_path != NULL)
+        evaluate_program_columns();
+    else if (parse_ret == 0)
+        execute_program();
+
+    if (stats_format != STATS_OFF)
+        print_stats(stdout);
+    close_columns();
+    free_compilation(c);
+    arena_free_all();
 
     printf("\n");
     return parse_ret;